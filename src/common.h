@@ -33,6 +33,16 @@ static const int MAX_MERGE_AT_ONCE = 4;
 static const int MAX_SEGMENTS_PER_TIER = 3;
 static const int MAX_SEGMENT_BLOCKS = 4 * 1024 * 1024;
 static const int FLOOR_SEGMENT_BLOCKS = 1024;
+static const int MAX_SEGMENT_FILTER_KEYS = 4 * 1024 * 1024;
+static const int MAX_SEGMENT_HEAVY_KEYS = 1024;
+static const int MIN_SEGMENT_POSTING_LIST_SIZE = 1024;
+static const int MAX_BLOCK_CACHE_SIZE = 64 * 1024 * 1024;
+
+// Segment data formats, new segments are always written in the latest one
+static const int SEGMENT_FORMAT_V1 = 1; // interleaved key/value varints
+static const int SEGMENT_FORMAT_V2 = 2; // separate StreamVByte key and value arrays
+static const int SEGMENT_FORMAT_V3 = 3; // v2 with block sketches in the index file
+static const int SEGMENT_FORMAT_VERSION = SEGMENT_FORMAT_V3;
 
 #define ACOUSTID_DISABLE_COPY(ClassName)	\
 	ClassName(const ClassName &);			\
@@ -0,0 +1,158 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include "block_cache.h"
+
+namespace Acoustid {
+
+uint qHash(const BlockCache::Key &key, uint seed)
+{
+	uint64_t hash = (key.segment ^ key.block) * UINT64_C(0x9E3779B97F4A7C15);
+	return uint(hash >> 32) ^ seed;
+}
+
+}
+
+using namespace Acoustid;
+
+BlockCache::BlockCache(size_t maxSize)
+	: m_maxSize(maxSize), m_hitCount(0), m_missCount(0)
+{
+	for (int i = 0; i < kShardCount; i++) {
+		m_shards[i].hand = 0;
+		m_shards[i].size = 0;
+	}
+}
+
+BlockCache::~BlockCache()
+{
+}
+
+BlockCache *BlockCache::instance()
+{
+	static BlockCache cache;
+	return &cache;
+}
+
+void BlockCache::setMaxSize(size_t maxSize)
+{
+	m_maxSize = maxSize;
+	for (int i = 0; i < kShardCount; i++) {
+		QMutexLocker locker(&m_shards[i].mutex);
+		evict(m_shards[i], maxSize / kShardCount);
+	}
+}
+
+size_t BlockCache::size()
+{
+	size_t size = 0;
+	for (int i = 0; i < kShardCount; i++) {
+		QMutexLocker locker(&m_shards[i].mutex);
+		size += m_shards[i].size;
+	}
+	return size;
+}
+
+BlockCache::Shard &BlockCache::shard(const Key &key)
+{
+	// The top bits, the bottom ones are used by the hash table in the shard
+	return m_shards[(qHash(key, 0) >> 28) % kShardCount];
+}
+
+CachedBlockSharedPtr BlockCache::find(uint64_t segment, uint32_t block)
+{
+	if (!m_maxSize) {
+		return CachedBlockSharedPtr();
+	}
+	Key key = { segment, block };
+	Shard &shard = this->shard(key);
+	QMutexLocker locker(&shard.mutex);
+	size_t pos = shard.positions.value(key, SIZE_MAX);
+	if (pos == SIZE_MAX) {
+		m_missCount++;
+		return CachedBlockSharedPtr();
+	}
+	Entry &entry = shard.entries[pos];
+	entry.referenced = true;
+	m_hitCount++;
+	return entry.data;
+}
+
+void BlockCache::insert(uint64_t segment, uint32_t block, CachedBlockSharedPtr data)
+{
+	size_t maxShardSize = m_maxSize / kShardCount;
+	if (data->size() > maxShardSize) {
+		return;
+	}
+	Key key = { segment, block };
+	Shard &shard = this->shard(key);
+	QMutexLocker locker(&shard.mutex);
+	if (shard.positions.contains(key)) {
+		// Another search was faster
+		return;
+	}
+	evict(shard, maxShardSize - data->size());
+	Entry entry = { key, data, false };
+	shard.positions.insert(key, shard.entries.size());
+	shard.entries.push_back(entry);
+	shard.size += data->size();
+}
+
+void BlockCache::removeBlock(uint64_t segment, uint32_t block)
+{
+	Key key = { segment, block };
+	Shard &shard = this->shard(key);
+	QMutexLocker locker(&shard.mutex);
+	size_t pos = shard.positions.value(key, SIZE_MAX);
+	if (pos != SIZE_MAX) {
+		remove(shard, pos);
+	}
+}
+
+void BlockCache::removeSegment(uint64_t segment)
+{
+	for (int i = 0; i < kShardCount; i++) {
+		Shard &shard = m_shards[i];
+		QMutexLocker locker(&shard.mutex);
+		size_t pos = 0;
+		while (pos < shard.entries.size()) {
+			if (shard.entries[pos].key.segment == segment) {
+				remove(shard, pos);
+			}
+			else {
+				pos++;
+			}
+		}
+	}
+}
+
+// Evict entries until the shard fits into the size. Entries that were
+// used since the clock hand last passed them get a second chance.
+void BlockCache::evict(Shard &shard, size_t maxSize)
+{
+	while (shard.size > maxSize && !shard.entries.empty()) {
+		if (shard.hand >= shard.entries.size()) {
+			shard.hand = 0;
+		}
+		Entry &entry = shard.entries[shard.hand];
+		if (entry.referenced) {
+			entry.referenced = false;
+			shard.hand++;
+		}
+		else {
+			remove(shard, shard.hand);
+		}
+	}
+}
+
+// Remove the entry, the last one is moved to its position.
+void BlockCache::remove(Shard &shard, size_t pos)
+{
+	shard.size -= shard.entries[pos].data->size();
+	shard.positions.remove(shard.entries[pos].key);
+	if (pos + 1 < shard.entries.size()) {
+		shard.entries[pos] = shard.entries.back();
+		shard.positions.insert(shard.entries[pos].key, pos);
+	}
+	shard.entries.pop_back();
+}
@@ -0,0 +1,117 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_INDEX_BLOCK_CACHE_H_
+#define ACOUSTID_INDEX_BLOCK_CACHE_H_
+
+#include <atomic>
+#include <vector>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include "common.h"
+
+namespace Acoustid {
+
+// Decoded keys and values of one block
+class CachedBlock
+{
+public:
+	CachedBlock(size_t length, const uint32_t *keys, const uint32_t *values)
+		: m_length(length), m_data(new uint32_t[2 * length])
+	{
+		std::copy(keys, keys + length, m_data.get());
+		std::copy(values, values + length, m_data.get() + length);
+	}
+
+	size_t length() const { return m_length; }
+	const uint32_t *keys() const { return m_data.get(); }
+	const uint32_t *values() const { return m_data.get() + m_length; }
+
+	// Approximate memory used by the block in the cache
+	size_t size() const { return sizeof(CachedBlock) + 2 * m_length * sizeof(uint32_t); }
+
+private:
+	size_t m_length;
+	std::unique_ptr<uint32_t[]> m_data;
+};
+
+typedef QSharedPointer<const CachedBlock> CachedBlockSharedPtr;
+
+// Memory-capped cache of decoded blocks, shared by all searches. Blocks
+// are identified by a segment key, which must be unique in the process,
+// and the block number. Entries are evicted using the CLOCK algorithm,
+// the cache is split into shards with separate locks.
+class BlockCache
+{
+public:
+	BlockCache(size_t maxSize = MAX_BLOCK_CACHE_SIZE);
+	~BlockCache();
+
+	// The process-wide cache
+	static BlockCache *instance();
+
+	size_t maxSize() const { return m_maxSize; }
+	void setMaxSize(size_t maxSize);
+
+	// Memory used by the cached blocks
+	size_t size();
+
+	CachedBlockSharedPtr find(uint64_t segment, uint32_t block);
+	void insert(uint64_t segment, uint32_t block, CachedBlockSharedPtr data);
+
+	void removeBlock(uint64_t segment, uint32_t block);
+
+	// Drop all blocks of the segment
+	void removeSegment(uint64_t segment);
+
+	uint64_t hitCount() const { return m_hitCount; }
+	uint64_t missCount() const { return m_missCount; }
+
+private:
+	ACOUSTID_DISABLE_COPY(BlockCache);
+
+	static const int kShardCount = 16;
+
+	struct Key
+	{
+		uint64_t segment;
+		uint32_t block;
+
+		bool operator==(const Key &other) const
+		{
+			return segment == other.segment && block == other.block;
+		}
+	};
+
+	friend uint qHash(const Key &key, uint seed);
+
+	struct Entry
+	{
+		Key key;
+		CachedBlockSharedPtr data;
+		bool referenced;
+	};
+
+	struct Shard
+	{
+		QMutex mutex;
+		QHash<Key, size_t> positions;
+		std::vector<Entry> entries;
+		size_t hand;
+		size_t size;
+	};
+
+	Shard &shard(const Key &key);
+	void evict(Shard &shard, size_t maxSize);
+	void remove(Shard &shard, size_t pos);
+
+	std::atomic<size_t> m_maxSize;
+	Shard m_shards[kShardCount];
+	std::atomic<uint64_t> m_hitCount;
+	std::atomic<uint64_t> m_missCount;
+};
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <gtest/gtest.h>
+#include "util/test_utils.h"
+#include "block_cache.h"
+
+using namespace Acoustid;
+
+static CachedBlockSharedPtr makeBlock(size_t length, uint32_t key)
+{
+	std::vector<uint32_t> keys(length, key), values(length, key + 1);
+	return CachedBlockSharedPtr(new CachedBlock(length, keys.data(), values.data()));
+}
+
+TEST(BlockCacheTest, FindAndInsert)
+{
+	BlockCache cache;
+	ASSERT_TRUE(cache.find(1, 0).isNull());
+	ASSERT_EQ(1, cache.missCount());
+
+	cache.insert(1, 0, makeBlock(10, 100));
+	CachedBlockSharedPtr block = cache.find(1, 0);
+	ASSERT_FALSE(block.isNull());
+	ASSERT_EQ(10, block->length());
+	ASSERT_EQ(100, block->keys()[9]);
+	ASSERT_EQ(101, block->values()[9]);
+	ASSERT_EQ(1, cache.hitCount());
+
+	ASSERT_TRUE(cache.find(1, 1).isNull());
+	ASSERT_TRUE(cache.find(2, 0).isNull());
+	ASSERT_EQ(3, cache.missCount());
+	ASSERT_EQ(block->size(), cache.size());
+}
+
+TEST(BlockCacheTest, Evict)
+{
+	size_t blockSize = makeBlock(100, 0)->size();
+	BlockCache cache(100 * blockSize);
+	for (uint32_t i = 0; i < 1000; i++) {
+		cache.insert(1, i, makeBlock(100, i));
+		// Keep using the first block, so that it's never evicted
+		ASSERT_FALSE(cache.find(1, 0).isNull());
+	}
+	ASSERT_LE(cache.size(), 100 * blockSize);
+	ASSERT_GT(cache.size(), 0);
+	ASSERT_FALSE(cache.find(1, 999).isNull());
+
+	cache.setMaxSize(0);
+	ASSERT_EQ(0, cache.size());
+	ASSERT_TRUE(cache.find(1, 999).isNull());
+}
+
+TEST(BlockCacheTest, RemoveSegment)
+{
+	BlockCache cache;
+	for (uint32_t i = 0; i < 100; i++) {
+		cache.insert(1, i, makeBlock(10, i));
+		cache.insert(2, i, makeBlock(10, i));
+	}
+	cache.removeSegment(1);
+	for (uint32_t i = 0; i < 100; i++) {
+		ASSERT_TRUE(cache.find(1, i).isNull());
+		ASSERT_FALSE(cache.find(2, i).isNull());
+	}
+	ASSERT_EQ(100 * makeBlock(10, 0)->size(), cache.size());
+}
@@ -4,6 +4,7 @@
 #ifndef ACOUSTID_INDEX_COLLECTOR_H_
 #define ACOUSTID_INDEX_COLLECTOR_H_
 
+#include <QHash>
 #include "common.h"
 
 namespace Acoustid {
@@ -13,6 +14,46 @@ class Collector
 public:
 	virtual ~Collector() {}
 	virtual void collect(uint32_t id) = 0;
+
+	// Collect the id count times
+	virtual void collectMany(uint32_t id, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++) {
+			collect(id);
+		}
+	}
+};
+
+// Collector that only counts the hits of each id, so that hits found on
+// a worker thread can be passed to the real collector later. Its size
+// depends on the number of distinct ids, not on the number of hits.
+class BufferedCollector : public Collector
+{
+public:
+	void collect(uint32_t id)
+	{
+		m_counts[id]++;
+	}
+
+	void collectMany(uint32_t id, unsigned int count)
+	{
+		m_counts[id] += count;
+	}
+
+	void replay(Collector *collector) const
+	{
+		for (QHash<uint32_t, unsigned int>::const_iterator it = m_counts.begin(); it != m_counts.end(); ++it) {
+			collector->collectMany(it.key(), it.value());
+		}
+	}
+
+	void clear()
+	{
+		m_counts.clear();
+	}
+
+private:
+	QHash<uint32_t, unsigned int> m_counts;
 };
 
 }
@@ -1,42 +1,85 @@
 // Copyright (C) 2011  Lukas Lalinsky
 // Distributed under the MIT license, see the LICENSE file for details.
 
+#include <atomic>
+#include <QHash>
+#include <QSet>
 #include "store/directory.h"
 #include "store/input_stream.h"
 #include "store/output_stream.h"
 #include "segment_index_reader.h"
 #include "segment_data_reader.h"
 #include "segment_searcher.h"
-#include "index_file_deleter.h"
+#include "block_cache.h"
+#include "search_result_cache.h"
 #include "index_reader.h"
 #include "index_writer.h"
 #include "index.h"
 
 using namespace Acoustid;
 
+static std::atomic<uint32_t> lastIndexId(0);
+
 Index::Index(DirectorySharedPtr dir, bool create)
-	: m_mutex(QMutex::Recursive), m_dir(dir), m_open(false),
+	: m_id(++lastIndexId),
+	  m_mutex(QMutex::Recursive), m_dir(dir),
 	  m_hasWriter(false),
-	  m_deleter(new IndexFileDeleter(dir))
+	  m_resultCache(new SearchResultCache())
 {
 	open(create);
 }
 
 Index::~Index()
 {
+	removeFromBlockCache(info(), IndexInfo());
+}
+
+// Drop cached blocks of the segments that are not in keepInfo
+void Index::removeFromBlockCache(const IndexInfo& info, const IndexInfo& keepInfo)
+{
+	QSet<int> keep;
+	for (int i = 0; i < keepInfo.segmentCount(); i++) {
+		keep.insert(keepInfo.segment(i).id());
+	}
+	for (int i = 0; i < info.segmentCount(); i++) {
+		if (!keep.contains(info.segment(i).id())) {
+			BlockCache::instance()->removeSegment(blockCacheKey(info.segment(i)));
+		}
+	}
 }
 
 void Index::open(bool create)
 {
-	if (!m_info.load(m_dir.data(), true)) {
+	IndexInfo info;
+	if (!info.load(m_dir.data(), true)) {
 		if (create) {
-			IndexWriter(m_dir, m_info).commit();
+			IndexWriter(m_dir, info).commit();
 			return open(false);
 	 	}
 		throw IOException("there is no index in the directory");
 	}
-	m_deleter->incRef(m_info);
-	m_open = true;
+
+	// Segments that are already in the current snapshot must keep their
+	// file refs, otherwise marking one copy obsolete would delete files
+	// that the other snapshots still read.
+	QHash<int, SegmentFileRefSharedPtr> fileRefs;
+	std::shared_ptr<const IndexInfo> currentInfo = std::atomic_load(&m_info);
+	if (currentInfo) {
+		for (int i = 0; i < currentInfo->segmentCount(); i++) {
+			const SegmentInfo& segment = currentInfo->segment(i);
+			fileRefs.insert(segment.id(), segment.fileRef());
+		}
+	}
+	for (int i = 0; i < info.segmentCount(); i++) {
+		SegmentInfo& segment = info.segments()[i];
+		SegmentFileRefSharedPtr fileRef = fileRefs.value(segment.id());
+		if (!fileRef) {
+			fileRef = SegmentFileRefSharedPtr(new SegmentFileRef(m_dir, segment.files()));
+		}
+		segment.setFileRef(fileRef);
+	}
+
+	std::atomic_store(&m_info, std::shared_ptr<const IndexInfo>(new IndexInfo(info)));
 }
 
 void Index::acquireWriterLock()
@@ -54,42 +97,33 @@ void Index::releaseWriterLock()
 	m_hasWriter = false;
 }
 
-IndexInfo Index::acquireInfo()
+void Index::updateInfo(const IndexInfo& info)
 {
 	QMutexLocker locker(&m_mutex);
-	IndexInfo info = m_info;
-	if (m_open) {
-		m_deleter->incRef(info);
+	for (int i = 0; i < info.segmentCount(); i++) {
+		assert(!info.segment(i).index().isNull());
 	}
-	//qDebug() << "acquireInfo" << info.files();
-	return info;
-}
+	IndexInfo oldInfo = this->info();
+	std::atomic_store(&m_info, std::shared_ptr<const IndexInfo>(new IndexInfo(info)));
 
-void Index::releaseInfo(const IndexInfo& info)
-{
-	QMutexLocker locker(&m_mutex);
-	if (m_open) {
-		m_deleter->decRef(info);
+	// Segments that were merged away won't be searched anymore
+	QSet<int> segmentIds;
+	for (int i = 0; i < info.segmentCount(); i++) {
+		segmentIds.insert(info.segment(i).id());
 	}
-	//qDebug() << "releaseInfo" << info.files();
-}
-
-void Index::updateInfo(const IndexInfo& oldInfo, const IndexInfo& newInfo, bool updateIndex)
-{
-	QMutexLocker locker(&m_mutex);
-	if (m_open) {
-		// the infos are opened twice (index + writer), so we need to inc/dec-ref them twice too
-		m_deleter->incRef(newInfo);
-		if (updateIndex) {
-			m_deleter->incRef(newInfo);
-			m_deleter->decRef(m_info);
+	for (int i = 0; i < oldInfo.segmentCount(); i++) {
+		const SegmentInfo& segment = oldInfo.segment(i);
+		if (!segmentIds.contains(segment.id()) && segment.fileRef()) {
+			segment.fileRef()->markObsolete();
 		}
-		m_deleter->decRef(oldInfo);
 	}
-	if (updateIndex) {
-		m_info = newInfo;
-		for (int i = 0; i < m_info.segmentCount(); i++) {
-			assert(!m_info.segment(i).index().isNull());
-		}
+	removeFromBlockCache(oldInfo, info);
+	m_resultCache->clear();
+
+	// Readers only need the loaded snapshot, not the file it came from
+	if (oldInfo.revision() != info.revision()) {
+		QString fileName = IndexInfo::indexInfoFileName(oldInfo.revision());
+		qDebug() << "Deleting file" << fileName;
+		m_dir->deleteFile(fileName);
 	}
 }
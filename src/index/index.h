@@ -4,6 +4,7 @@
 #ifndef ACOUSTID_INDEX_H_
 #define ACOUSTID_INDEX_H_
 
+#include <memory>
 #include <QMutex>
 #include "common.h"
 #include "index.h"
@@ -13,7 +14,7 @@
 
 namespace Acoustid {
 
-class IndexFileDeleter;
+class SearchResultCache;
 
 // Class for working with an on-disk index.
 //
@@ -32,29 +33,45 @@ public:
 		return m_dir;
 	}
 
-	IndexInfo info()
+	// Current snapshot of the index. Snapshots are immutable, segment files
+	// are kept until the last copy of the snapshot which uses them is gone.
+	IndexInfo info() const
 	{
-		return m_info;
+		return *std::atomic_load(&m_info);
+	}
+
+	// Key of the segment in the block cache, unique in the process
+	uint64_t blockCacheKey(const SegmentInfo& segment) const
+	{
+		return (uint64_t(m_id) << 32) | uint32_t(segment.id());
+	}
+
+	// Cache of search results, shared by all searchers of the index
+	SearchResultCache *resultCache()
+	{
+		return m_resultCache.get();
 	}
 
 	void acquireWriterLock();
 	void releaseWriterLock();
 
-	IndexInfo acquireInfo();
-	void releaseInfo(const IndexInfo& info);
-	void updateInfo(const IndexInfo& oldInfo, const IndexInfo& newInfo, bool updateIndex = false);
+	// Publish a new snapshot. Segments that are not in it anymore are
+	// deleted once the readers of the previous snapshots are finished.
+	void updateInfo(const IndexInfo& info);
 
 private:
 	ACOUSTID_DISABLE_COPY(Index);
 
 	void open(bool create);
+	void removeFromBlockCache(const IndexInfo& info, const IndexInfo& keepInfo);
 
+	uint32_t m_id;
 	QMutex m_mutex;
 	DirectorySharedPtr m_dir;
 	bool m_hasWriter;
-	std::unique_ptr<IndexFileDeleter> m_deleter;
-	IndexInfo m_info;
-	bool m_open;
+	std::unique_ptr<SearchResultCache> m_resultCache;
+	// Only accessed with std::atomic_load/atomic_store
+	std::shared_ptr<const IndexInfo> m_info;
 };
 
 typedef QWeakPointer<Index> IndexWeakPtr;
@@ -5,12 +5,27 @@
 #include "store/input_stream.h"
 #include "store/output_stream.h"
 #include "segment_index_reader.h"
+#include "segment_filter.h"
+#include "segment_heavy_keys.h"
+#include "segment_postings.h"
 #include "store/checksum_input_stream.h"
 #include "store/checksum_output_stream.h"
 #include "index_info.h"
 
 using namespace Acoustid;
 
+// Index info files used to start directly with the last segment ID. Since
+// segments have versions, they start with this marker and the info format.
+static const uint32_t kIndexInfoMarker = UINT32_MAX;
+static const uint32_t kIndexInfoFormatV1 = 1;
+static const uint32_t kIndexInfoFormatV2 = 2;
+static const uint32_t kIndexInfoFormatV3 = 3; // v2 with per-segment flags
+
+// Segment flags
+static const uint32_t kSegmentHasFilter = 1;
+static const uint32_t kSegmentHasHeavyKeys = 2;
+static const uint32_t kSegmentHasPostings = 4;
+
 QList<QString> IndexInfo::files(bool includeIndexInfo) const
 {
 	QList<QString> files;
@@ -80,7 +95,16 @@ bool IndexInfo::load(Directory* dir, bool loadIndexes)
 void IndexInfo::load(InputStream* rawInput, bool loadIndexes, Directory* dir)
 {
 	std::unique_ptr<ChecksumInputStream> input(new ChecksumInputStream(rawInput));
-	setLastSegmentId(input->readVInt32());
+	uint32_t format = kIndexInfoFormatV1;
+	uint32_t lastSegmentId = input->readVInt32();
+	if (lastSegmentId == kIndexInfoMarker) {
+		format = input->readVInt32();
+		if (format != kIndexInfoFormatV2 && format != kIndexInfoFormatV3) {
+			throw CorruptIndexException(QString("unsupported index info format %1").arg(format));
+		}
+		lastSegmentId = input->readVInt32();
+	}
+	setLastSegmentId(lastSegmentId);
 	clearSegments();
 	size_t segmentCount = input->readVInt32();
 	for (size_t i = 0; i < segmentCount; i++) {
@@ -89,8 +113,40 @@ void IndexInfo::load(InputStream* rawInput, bool loadIndexes, Directory* dir)
 		uint32_t lastKey = input->readVInt32();
 		uint32_t checksum = input->readVInt32();
 		SegmentInfo segment(id, blockCount, lastKey, checksum);
+		if (format == kIndexInfoFormatV1) {
+			segment.setVersion(SEGMENT_FORMAT_V1);
+		}
+		else {
+			uint32_t version = input->readVInt32();
+			if (version < SEGMENT_FORMAT_V1 || version > SEGMENT_FORMAT_VERSION) {
+				throw CorruptIndexException(QString("unsupported segment format %1").arg(version));
+			}
+			segment.setVersion(version);
+		}
+		if (format >= kIndexInfoFormatV3) {
+			uint32_t flags = input->readVInt32();
+			if (flags & ~(kSegmentHasFilter | kSegmentHasHeavyKeys | kSegmentHasPostings)) {
+				throw CorruptIndexException(QString("unsupported segment flags %1").arg(flags));
+			}
+			segment.setHasFilter(flags & kSegmentHasFilter);
+			segment.setHasHeavyKeys(flags & kSegmentHasHeavyKeys);
+			segment.setHasPostings(flags & kSegmentHasPostings);
+		}
 		if (loadIndexes) {
-			segment.setIndex(SegmentIndexReader(dir->openFile(segment.indexFileName()), segment.blockCount()).read());
+			segment.setIndex(SegmentIndexReader(dir->openFile(segment.indexFileName()), segment.blockCount(), segment.version()).read());
+			if (segment.hasFilter()) {
+				std::unique_ptr<InputStream> filterInput(dir->openFile(segment.filterFileName()));
+				segment.setFilter(SegmentFilter::load(filterInput.get()));
+			}
+			if (segment.hasHeavyKeys()) {
+				std::unique_ptr<InputStream> heavyKeysInput(dir->openFile(segment.heavyKeysFileName()));
+				segment.setHeavyKeys(SegmentHeavyKeys::load(heavyKeysInput.get()));
+			}
+			if (segment.hasPostings()) {
+				std::unique_ptr<InputStream> postingsInput(dir->openFile(segment.postingsFileName()));
+				segment.setPostings(SegmentPostings::load(postingsInput.get()));
+			}
+			segment.setDataFile(dir->openInputFile(segment.dataFileName()));
 		}
 		addSegment(segment);
 	}
@@ -122,6 +178,8 @@ void IndexInfo::save(Directory* dir)
 void IndexInfo::save(OutputStream *rawOutput)
 {
 	std::unique_ptr<ChecksumOutputStream> output(new ChecksumOutputStream(rawOutput));
+	output->writeVInt32(kIndexInfoMarker);
+	output->writeVInt32(kIndexInfoFormatV3);
 	output->writeVInt32(lastSegmentId());
 	output->writeVInt32(segmentCount());
 	for (size_t i = 0; i < segmentCount(); i++) {
@@ -129,6 +187,18 @@ void IndexInfo::save(OutputStream *rawOutput)
 		output->writeVInt32(d->segments.at(i).blockCount());
 		output->writeVInt32(d->segments.at(i).lastKey());
 		output->writeVInt32(d->segments.at(i).checksum());
+		output->writeVInt32(d->segments.at(i).version());
+		uint32_t flags = 0;
+		if (d->segments.at(i).hasFilter()) {
+			flags |= kSegmentHasFilter;
+		}
+		if (d->segments.at(i).hasHeavyKeys()) {
+			flags |= kSegmentHasHeavyKeys;
+		}
+		if (d->segments.at(i).hasPostings()) {
+			flags |= kSegmentHasPostings;
+		}
+		output->writeVInt32(flags);
 	}
 	{
 		QMapIterator<QString, QString> i(d->attribs);
@@ -64,6 +64,7 @@ TEST(IndexInfoTest, ReadFromDir)
 	ASSERT_EQ(66, infos.segment(1).blockCount());
 	ASSERT_EQ(200, infos.segment(1).lastKey());
 	ASSERT_EQ(456, infos.segment(1).checksum());
+	ASSERT_EQ(SEGMENT_FORMAT_V1, infos.segment(1).version());
 	ASSERT_EQ(1, infos.attributes().size());
 	ASSERT_EQ("bar", infos.attribute("foo"));
 }
@@ -186,28 +187,72 @@ TEST(IndexInfoTest, WriteIntoDir)
 	RAMDirectory dir;
 
 	IndexInfo infos;
-	infos.addSegment(SegmentInfo(0, 42, 100, 123));
+	SegmentInfo segment0(0, 42, 100, 123);
+	segment0.setVersion(SEGMENT_FORMAT_V1);
+	infos.addSegment(segment0);
 	infos.incLastSegmentId();
-	infos.addSegment(SegmentInfo(1, 66, 200, 456));
+	SegmentInfo segment1(1, 66, 200, 456);
+	segment1.setHasFilter(true);
+	infos.addSegment(segment1);
 	infos.incLastSegmentId();
 	infos.setAttribute("foo", "bar");
 	infos.save(&dir);
 
 	std::unique_ptr<InputStream> input(dir.openFile("info_0"));
+	ASSERT_EQ(UINT32_MAX, input->readVInt32());
+	ASSERT_EQ(3, input->readVInt32());
 	ASSERT_EQ(2, input->readVInt32());
 	ASSERT_EQ(2, input->readVInt32());
 	ASSERT_EQ(0, input->readVInt32());
 	ASSERT_EQ(42, input->readVInt32());
 	ASSERT_EQ(100, input->readVInt32());
 	ASSERT_EQ(123, input->readVInt32());
+	ASSERT_EQ(SEGMENT_FORMAT_V1, input->readVInt32());
+	ASSERT_EQ(0, input->readVInt32());
 	ASSERT_EQ(1, input->readVInt32());
 	ASSERT_EQ(66, input->readVInt32());
 	ASSERT_EQ(200, input->readVInt32());
 	ASSERT_EQ(456, input->readVInt32());
+	ASSERT_EQ(SEGMENT_FORMAT_V3, input->readVInt32());
+	ASSERT_EQ(1, input->readVInt32());
 	ASSERT_EQ(1, input->readVInt32());
 	ASSERT_EQ("foo", input->readString());
 	ASSERT_EQ("bar", input->readString());
-	ASSERT_EQ(3656423981u, input->readInt32());
+	ASSERT_EQ(3475267305u, input->readInt32());
+}
+
+TEST(IndexInfoTest, WriteAndReadSegmentVersions)
+{
+	RAMDirectory dir;
+
+	IndexInfo infos;
+	SegmentInfo segment0(0, 42, 100, 123);
+	segment0.setVersion(SEGMENT_FORMAT_V1);
+	segment0.setHasHeavyKeys(true);
+	infos.addSegment(segment0);
+	infos.incLastSegmentId();
+	SegmentInfo segment1(1, 66, 200, 456);
+	segment1.setHasFilter(true);
+	segment1.setHasPostings(true);
+	infos.addSegment(segment1);
+	infos.incLastSegmentId();
+	infos.save(&dir);
+
+	IndexInfo infos2;
+	infos2.load(&dir);
+	ASSERT_EQ(2, infos2.lastSegmentId());
+	ASSERT_EQ(2, infos2.segmentCount());
+	ASSERT_EQ(SEGMENT_FORMAT_V1, infos2.segment(0).version());
+	ASSERT_EQ(42, infos2.segment(0).blockCount());
+	ASSERT_FALSE(infos2.segment(0).hasFilter());
+	ASSERT_TRUE(infos2.segment(0).hasHeavyKeys());
+	ASSERT_FALSE(infos2.segment(0).hasPostings());
+	ASSERT_EQ(SEGMENT_FORMAT_V3, infos2.segment(1).version());
+	ASSERT_EQ(456, infos2.segment(1).checksum());
+	ASSERT_TRUE(infos2.segment(1).hasFilter());
+	ASSERT_FALSE(infos2.segment(1).hasHeavyKeys());
+	ASSERT_TRUE(infos2.segment(1).hasPostings());
+	ASSERT_EQ(QList<QString>() << "segment_1.fii" << "segment_1.fid" << "segment_1.fif" << "segment_1.fip", infos2.segment(1).files());
 }
 
 TEST(IndexInfoTest, Clear)
@@ -2,49 +2,478 @@
 // Distributed under the MIT license, see the LICENSE file for details.
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <QThreadPool>
+#include <QtConcurrent>
 #include "store/directory.h"
 #include "store/input_stream.h"
 #include "store/output_stream.h"
 #include "segment_index_reader.h"
 #include "segment_data_reader.h"
 #include "segment_searcher.h"
+#include "block_cache.h"
+#include "collector.h"
+#include "top_hits_collector.h"
+#include "index_utils.h"
 #include "index.h"
 #include "index_reader.h"
 
 using namespace Acoustid;
 
 IndexReader::IndexReader(DirectorySharedPtr dir, const IndexInfo& info)
-	: m_dir(dir), m_info(info)
+	: m_dir(dir), m_info(info), m_maxSearchThreads(1), m_maxTermFrequency(0),
+	  m_searchStrategy(ExactSearch), m_sampleBits(2), m_candidateCount(100), m_timeout(0), m_truncated(false)
 {
 }
 
 IndexReader::IndexReader(IndexSharedPtr index)
-	: m_dir(index->directory()), m_index(index)
+	: m_dir(index->directory()), m_info(index->info()), m_index(index), m_maxSearchThreads(1), m_maxTermFrequency(0),
+	  m_searchStrategy(ExactSearch), m_sampleBits(2), m_candidateCount(100), m_timeout(0), m_truncated(false)
 {
-	m_info = m_index->acquireInfo();
 }
 
 IndexReader::~IndexReader()
 {
+}
+
+SegmentDataReader* IndexReader::segmentDataReader(const SegmentInfo& segment)
+{
+	if (segment.dataFile()) {
+		return new SegmentDataReader(segment.dataFile(), BLOCK_SIZE, segment.version());
+	}
+	return new SegmentDataReader(m_dir->openFile(segment.dataFileName()), BLOCK_SIZE, segment.version());
+}
+
+SegmentSearcher* IndexReader::segmentSearcher(const SegmentInfo& segment)
+{
+	SegmentDataReader* dataReader = segmentDataReader(segment);
 	if (m_index) {
-		m_index->releaseInfo(m_info);
+		dataReader->setBlockCache(BlockCache::instance(), m_index->blockCacheKey(segment), segment.fileRef());
+	}
+	SegmentSearcher* searcher = new SegmentSearcher(segment.index(), dataReader, segment.lastKey());
+	searcher->setPostings(segment.postings());
+	if (m_timeout) {
+		searcher->setDeadline(m_deadline);
 	}
+	return searcher;
 }
 
-SegmentDataReader* IndexReader::segmentDataReader(const SegmentInfo& segment)
+// Estimated work of searching the terms in the segment, in blocks. Posting
+// lists count as the number of blocks their data would fill.
+size_t IndexReader::segmentBlocks(const SegmentInfo& segment, const uint32_t *terms, size_t length)
 {
-	return new SegmentDataReader(m_dir->openFile(segment.dataFileName()), BLOCK_SIZE);
+	if (!length) {
+		return 0;
+	}
+	size_t blocks = segment.blockCount();
+	if (segment.postings()) {
+		blocks += segment.postings()->dataSize(terms, length) / BLOCK_SIZE;
+	}
+	return blocks;
+}
+
+void IndexReader::startSearch()
+{
+	m_truncated = false;
+	m_stats = SearchStats();
+	if (m_timeout) {
+		m_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout);
+	}
+}
+
+// Search threads get their own pool, so that searches started from the
+// global pool (e.g. by the server) can't starve themselves of workers.
+static QThreadPool *searchThreadPool()
+{
+	static QThreadPool pool;
+	return &pool;
+}
+
+int IndexReader::maxSearchThreadsLimit()
+{
+	return searchThreadPool()->maxThreadCount();
+}
+
+// Append the terms that can be in the segment according to its filter.
+static void filterTerms(const SegmentInfo& segment, const std::vector<uint32_t>& terms, std::vector<uint32_t>* result)
+{
+	for (size_t i = 0; i < terms.size(); i++) {
+		if (segment.mayContain(terms[i])) {
+			result->push_back(terms[i]);
+		}
+	}
+}
+
+size_t IndexReader::termFrequency(uint32_t term) const
+{
+	size_t frequency = 0;
+	const SegmentInfoList& segments = m_info.segments();
+	for (int i = 0; i < segments.size(); i++) {
+		frequency += segments.at(i).keyFrequency(term);
+	}
+	return frequency;
 }
 
 void IndexReader::search(const uint32_t* fingerprint, size_t length, Collector* collector)
 {
-    std::vector<uint32_t> fp(fingerprint, fingerprint + length);
+	startSearch();
+	std::vector<uint32_t> fp(fingerprint, fingerprint + length);
 	std::sort(fp.begin(), fp.end());
+	if (m_maxTermFrequency) {
+		fp.erase(std::remove_if(fp.begin(), fp.end(), [this](uint32_t term) {
+			return termFrequency(term) > m_maxTermFrequency;
+		}), fp.end());
+	}
+	if (m_searchStrategy == TwoPhaseSearch) {
+		searchTwoPhase(fp, collector);
+	}
+	else {
+		searchTerms(fp, collector);
+	}
+}
+
+// Counts hits only for the documents it was created with.
+class CandidateCollector : public Collector
+{
+public:
+	CandidateCollector(const QList<Result>& candidates)
+	{
+		for (int i = 0; i < candidates.size(); i++) {
+			m_counts.insert(candidates[i].id(), candidates[i].score());
+		}
+	}
+
+	void collect(uint32_t id)
+	{
+		QHash<uint32_t, unsigned int>::iterator it = m_counts.find(id);
+		if (it != m_counts.end()) {
+			++it.value();
+		}
+	}
+
+	// Pass all counted hits to the collector
+	void replay(Collector* collector) const
+	{
+		for (QHash<uint32_t, unsigned int>::const_iterator it = m_counts.begin(); it != m_counts.end(); ++it) {
+			collector->collectMany(it.key(), it.value());
+		}
+	}
+
+private:
+	QHash<uint32_t, unsigned int> m_counts;
+};
+
+// Hits of the query term at one position and its probes. They are
+// buffered while a segment is searched, and each document is passed on
+// only once.
+class ProbeCollector : public Collector
+{
+public:
+	void collect(uint32_t id)
+	{
+		m_hits.push_back(id);
+	}
+
+	// Pass the distinct documents to the collector and clear the hits
+	void flush(Collector* target)
+	{
+		std::sort(m_hits.begin(), m_hits.end());
+		for (size_t i = 0; i < m_hits.size(); i++) {
+			if (i == 0 || m_hits[i] != m_hits[i - 1]) {
+				target->collect(m_hits[i]);
+			}
+		}
+		m_hits.clear();
+	}
+
+private:
+	std::vector<uint32_t> m_hits;
+};
+
+// All probes are searched in one sorted pass over each segment, so probes
+// that fall into the same block share its decoding. With multiple threads,
+// each thread takes the next segment that is not searched yet.
+void IndexReader::searchProbes(const std::vector<uint32_t>& terms, Collector* collector)
+{
+	std::vector<uint64_t> items;
+	items.reserve(terms.size() * (m_probeMasks.size() + 1));
+	for (size_t i = 0; i < terms.size(); i++) {
+		items.push_back(packItem(terms[i], i));
+		for (size_t j = 0; j < m_probeMasks.size(); j++) {
+			uint32_t probe = terms[i] ^ m_probeMasks[j];
+			// The query terms are already checked by search()
+			if (m_maxTermFrequency && termFrequency(probe) > m_maxTermFrequency) {
+				continue;
+			}
+			items.push_back(packItem(probe, i));
+		}
+	}
+	std::sort(items.begin(), items.end());
+	items.erase(std::unique(items.begin(), items.end()), items.end());
+
 	const SegmentInfoList& segments = m_info.segments();
+	size_t maxThreads = std::min(m_maxSearchThreads, maxSearchThreadsLimit());
+	size_t numThreads = std::max(size_t(1), std::min(maxThreads, size_t(segments.size())));
+	std::vector<BufferedCollector> partials(numThreads);
+	std::vector<SearchStats> partialStats(numThreads);
+	std::atomic<int> nextSegment(0);
+	runSearchThreads(numThreads, [&](size_t group) {
+		Collector* groupCollector = numThreads > 1 ? &partials[group] : collector;
+		std::vector<ProbeCollector> probeCollectors(terms.size());
+		std::vector<Collector*> targets(terms.size());
+		for (size_t i = 0; i < terms.size(); i++) {
+			targets[i] = &probeCollectors[i];
+		}
+		std::vector<uint64_t> segmentItems;
+		for (int i = nextSegment++; i < segments.size(); i = nextSegment++) {
+			const SegmentInfo& s = segments.at(i);
+			segmentItems.clear();
+			for (size_t j = 0; j < items.size(); j++) {
+				if (s.mayContain(unpackItemKey(items[j]))) {
+					segmentItems.push_back(items[j]);
+				}
+			}
+			if (segmentItems.empty()) {
+				continue;
+			}
+			std::unique_ptr<SegmentSearcher> searcher(segmentSearcher(s));
+			searcher->searchMany(segmentItems.data(), segmentItems.size(), targets.data());
+			for (size_t j = 0; j < probeCollectors.size(); j++) {
+				probeCollectors[j].flush(groupCollector);
+			}
+			partialStats[group].segments++;
+			partialStats[group].add(searcher->stats());
+			if (searcher->isTruncated()) {
+				m_truncated = true;
+				break;
+			}
+		}
+	});
+
+	for (size_t i = 0; i < numThreads; i++) {
+		partials[i].replay(collector);
+		m_stats.add(partialStats[i]);
+	}
+}
+
+void IndexReader::searchTwoPhase(std::vector<uint32_t>& terms, Collector* collector)
+{
+	std::vector<uint32_t> sampledTerms, otherTerms;
+	for (size_t i = 0; i < terms.size(); i++) {
+		if (isSampledTerm(terms[i])) {
+			sampledTerms.push_back(terms[i]);
+		}
+		else {
+			otherTerms.push_back(terms[i]);
+		}
+	}
+	if (sampledTerms.empty() || otherTerms.empty()) {
+		searchTerms(terms, collector);
+		return;
+	}
+
+	TopHitsCollector topHits(m_candidateCount);
+	searchTerms(sampledTerms, &topHits);
+	QList<Result> candidates = topHits.topResults();
+	if (candidates.isEmpty()) {
+		return;
+	}
+
+	CandidateCollector candidateCollector(candidates);
+	searchTerms(otherTerms, &candidateCollector);
+	candidateCollector.replay(collector);
+}
+
+// Run func(group) for each group, the first one in the calling thread and
+// the others in the search thread pool. The first exception thrown by any
+// of them is rethrown after all of them finish.
+void IndexReader::runSearchThreads(size_t numThreads, const std::function<void(size_t)>& func)
+{
+	std::vector<std::exception_ptr> errors(numThreads);
+	auto runGroup = [&](size_t group) {
+		try {
+			func(group);
+		}
+		catch (...) {
+			errors[group] = std::current_exception();
+		}
+	};
+
+	QList<QFuture<void>> futures;
+	for (size_t i = 1; i < numThreads; i++) {
+		futures.append(QtConcurrent::run(searchThreadPool(), runGroup, i));
+	}
+	if (numThreads > 0) {
+		runGroup(0);
+	}
+	for (int i = 0; i < futures.size(); i++) {
+		futures[i].waitForFinished();
+	}
+
+	for (size_t i = 0; i < numThreads; i++) {
+		if (errors[i]) {
+			std::rethrow_exception(errors[i]);
+		}
+	}
+}
+
+void IndexReader::searchTerms(std::vector<uint32_t>& fp, Collector* collector)
+{
+	if (!m_probeMasks.empty()) {
+		searchProbes(fp, collector);
+		return;
+	}
+
+	const SegmentInfoList& segments = m_info.segments();
+	std::vector<uint32_t>& terms = m_segmentTerms;
+	if (m_maxSearchThreads <= 1) {
+		for (int i = 0; i < segments.size(); i++) {
+			const SegmentInfo& s = segments.at(i);
+			terms.clear();
+			filterTerms(s, fp, &terms);
+			if (terms.empty()) {
+				continue;
+			}
+			std::unique_ptr<SegmentSearcher> searcher(segmentSearcher(s));
+			searcher->search(terms.data(), terms.size(), collector);
+			m_stats.segments++;
+			m_stats.add(searcher->stats());
+			if (searcher->isTruncated()) {
+				m_truncated = true;
+				break;
+			}
+		}
+		return;
+	}
+
+	// Every part opens its own data reader, so never split more than the pool can run.
+	size_t maxThreads = std::min(m_maxSearchThreads, maxSearchThreadsLimit());
+	// The terms of segment i are terms[starts[i]] to terms[starts[i + 1]].
+	std::vector<size_t> starts(segments.size() + 1, 0);
+	size_t totalBlocks = 0;
+	terms.clear();
+	for (int i = 0; i < segments.size(); i++) {
+		filterTerms(segments.at(i), fp, &terms);
+		starts[i + 1] = terms.size();
+		totalBlocks += segmentBlocks(segments.at(i), terms.data() + starts[i], starts[i + 1] - starts[i]);
+	}
+
+	// Split the search into tasks. Small segments are searched as a whole,
+	// large ones (e.g. after an optimize) are split into several key ranges.
+	struct SearchTask {
+		std::unique_ptr<SegmentSearcher> searcher;
+		uint32_t *terms;
+		size_t length;
+		size_t blocks;
+	};
+	std::vector<SearchTask> tasks;
 	for (int i = 0; i < segments.size(); i++) {
 		const SegmentInfo& s = segments.at(i);
-		SegmentSearcher searcher(s.index(), segmentDataReader(s), s.lastKey());
-		searcher.search(fp.data(), fp.size(), collector);
+		uint32_t* segmentTerms = terms.data() + starts[i];
+		size_t length = starts[i + 1] - starts[i];
+		if (!length) {
+			continue;
+		}
+		m_stats.segments++;
+		size_t maxParts = std::max(size_t(1), maxThreads * segmentBlocks(s, segmentTerms, length) / std::max(totalBlocks, size_t(1)));
+		std::unique_ptr<SegmentSearcher> searcher(segmentSearcher(s));
+		std::vector<size_t> partStarts = searcher->partition(segmentTerms, length, maxParts);
+		for (size_t j = 0; j < partStarts.size(); j++) {
+			SearchTask task;
+			if (j > 0) {
+				searcher.reset(segmentSearcher(s));
+			}
+			task.searcher = std::move(searcher);
+			task.terms = segmentTerms + partStarts[j];
+			task.length = (j + 1 < partStarts.size() ? partStarts[j + 1] : length) - partStarts[j];
+			task.blocks = s.blockCount() / partStarts.size();
+			if (s.postings()) {
+				task.blocks += s.postings()->dataSize(task.terms, task.length) / BLOCK_SIZE;
+			}
+			tasks.push_back(std::move(task));
+		}
+	}
+
+	// Distribute the tasks over the threads, largest first, so that all
+	// threads have roughly the same number of blocks to search.
+	size_t numThreads = std::min(maxThreads, tasks.size());
+	std::sort(tasks.begin(), tasks.end(), [](const SearchTask& a, const SearchTask& b) {
+		return a.blocks > b.blocks;
+	});
+	std::vector<std::vector<SearchTask*>> groups(numThreads);
+	std::vector<size_t> groupBlocks(numThreads, 0);
+	for (size_t i = 0; i < tasks.size(); i++) {
+		size_t group = std::min_element(groupBlocks.begin(), groupBlocks.end()) - groupBlocks.begin();
+		groups[group].push_back(&tasks[i]);
+		groupBlocks[group] += tasks[i].blocks;
+	}
+
+	// Each thread collects its hits separately, they are merged afterwards.
+	std::vector<BufferedCollector> partials(numThreads);
+	std::vector<SearchStats> partialStats(numThreads);
+	runSearchThreads(numThreads, [&](size_t group) {
+		Collector* groupCollector = numThreads > 1 ? &partials[group] : collector;
+		for (size_t i = 0; i < groups[group].size(); i++) {
+			SearchTask* task = groups[group][i];
+			task->searcher->search(task->terms, task->length, groupCollector);
+			partialStats[group].add(task->searcher->stats());
+			if (task->searcher->isTruncated()) {
+				m_truncated = true;
+				break;
+			}
+		}
+	});
+
+	for (size_t i = 0; i < numThreads; i++) {
+		partials[i].replay(collector);
+		m_stats.add(partialStats[i]);
 	}
 }
 
+void IndexReader::searchMany(const std::vector<std::vector<uint32_t>>& fingerprints, const std::vector<Collector*>& collectors)
+{
+	assert(fingerprints.size() == collectors.size());
+	startSearch();
+	// Merge all fingerprints into one sorted stream of items tagged with
+	// the fingerprint number, so that each block is read only once.
+	std::vector<uint64_t> terms;
+	for (size_t i = 0; i < fingerprints.size(); i++) {
+		const std::vector<uint32_t>& fp = fingerprints[i];
+		for (size_t j = 0; j < fp.size(); j++) {
+			terms.push_back(packItem(fp[j], i));
+		}
+	}
+	std::sort(terms.begin(), terms.end());
+	terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+	if (m_maxTermFrequency) {
+		terms.erase(std::remove_if(terms.begin(), terms.end(), [this](uint64_t item) {
+			return termFrequency(unpackItemKey(item)) > m_maxTermFrequency;
+		}), terms.end());
+	}
+
+	std::vector<Collector*> targets(collectors);
+	std::vector<uint64_t> segmentTerms;
+	const SegmentInfoList& segments = m_info.segments();
+	for (int i = 0; i < segments.size(); i++) {
+		const SegmentInfo& s = segments.at(i);
+		segmentTerms.clear();
+		for (size_t j = 0; j < terms.size(); j++) {
+			if (s.mayContain(unpackItemKey(terms[j]))) {
+				segmentTerms.push_back(terms[j]);
+			}
+		}
+		if (segmentTerms.empty()) {
+			continue;
+		}
+		std::unique_ptr<SegmentSearcher> searcher(segmentSearcher(s));
+		searcher->searchMany(segmentTerms.data(), segmentTerms.size(), targets.data());
+		m_stats.segments++;
+		m_stats.add(searcher->stats());
+		if (searcher->isTruncated()) {
+			m_truncated = true;
+			break;
+		}
+	}
+}
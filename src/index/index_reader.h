@@ -4,20 +4,37 @@
 #ifndef ACOUSTID_INDEX_READER_H_
 #define ACOUSTID_INDEX_READER_H_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
 #include "common.h"
 #include "segment_index.h"
 #include "index.h"
 #include "index_info.h"
+#include "search_stats.h"
 
 namespace Acoustid {
 
 class SegmentIndex;
 class SegmentDataReader;
+class SegmentSearcher;
 class Collector;
 
 class IndexReader
 {
 public:
+	enum SearchStrategy {
+		// Search all terms
+		ExactSearch,
+		// Find candidate documents using a sample of the terms, then count
+		// the hits of the other terms only for the candidates. Documents
+		// that don't make it into the candidates are missed, but the
+		// candidates get their exact scores.
+		TwoPhaseSearch,
+	};
+
 	IndexReader(DirectorySharedPtr dir, const IndexInfo& info);
 	IndexReader(IndexSharedPtr index);
 	virtual ~IndexReader();
@@ -29,14 +46,157 @@ public:
 		return m_index;
 	}
 
+	// Maximum number of threads a single search can use. Segments are
+	// distributed over the threads, by default they are searched serially.
+	int maxSearchThreads() const
+	{
+		return m_maxSearchThreads;
+	}
+
+	// The value is limited to maxSearchThreadsLimit().
+	void setMaxSearchThreads(int maxSearchThreads)
+	{
+		m_maxSearchThreads = std::max(1, std::min(maxSearchThreads, maxSearchThreadsLimit()));
+	}
+
+	// Size of the thread pool used for parallel searches
+	static int maxSearchThreadsLimit();
+
+	// Terms that are in more documents than this are not searched, zero
+	// means no limit. Only the heavy keys of segments are known to be this
+	// frequent, so a term is never skipped based on an estimate.
+	size_t maxTermFrequency() const
+	{
+		return m_maxTermFrequency;
+	}
+
+	void setMaxTermFrequency(size_t maxTermFrequency)
+	{
+		m_maxTermFrequency = maxTermFrequency;
+	}
+
+	SearchStrategy searchStrategy() const
+	{
+		return m_searchStrategy;
+	}
+
+	void setSearchStrategy(SearchStrategy searchStrategy)
+	{
+		m_searchStrategy = searchStrategy;
+	}
+
+	// The first phase of TwoPhaseSearch uses 1 in 2^sampleBits terms, selected
+	// by their hash, so the same terms are sampled in every query.
+	int sampleBits() const
+	{
+		return m_sampleBits;
+	}
+
+	void setSampleBits(int sampleBits)
+	{
+		m_sampleBits = std::max(0, std::min(sampleBits, 16));
+	}
+
+	// Number of candidates kept after the first phase of TwoPhaseSearch
+	size_t candidateCount() const
+	{
+		return m_candidateCount;
+	}
+
+	void setCandidateCount(size_t candidateCount)
+	{
+		m_candidateCount = candidateCount;
+	}
+
+	// Whether the first phase of TwoPhaseSearch uses the term.
+	bool isSampledTerm(uint32_t term) const
+	{
+		return m_sampleBits == 0 || (term * UINT32_C(0x9E3779B1)) >> (32 - m_sampleBits) == 0;
+	}
+
+	// XOR masks of the neighbours of each query term that are searched as
+	// well, e.g. single bit flips. A document still gets at most one hit
+	// per query term in each segment. Probes are searched in both phases
+	// of TwoPhaseSearch, and segments are searched in parallel when
+	// multiple threads are allowed.
+	const std::vector<uint32_t>& probeMasks() const
+	{
+		return m_probeMasks;
+	}
+
+	void setProbeMasks(const std::vector<uint32_t>& probeMasks)
+	{
+		m_probeMasks = probeMasks;
+	}
+
+	// Searches stop after this many milliseconds and keep the hits found
+	// so far, zero means no limit. The time is only checked between
+	// segments and every few blocks, so a search can take a bit longer.
+	int timeout() const
+	{
+		return m_timeout;
+	}
+
+	void setTimeout(int timeout)
+	{
+		m_timeout = std::max(0, timeout);
+	}
+
+	// Whether the last search was stopped by the timeout
+	bool isTruncated() const
+	{
+		return m_truncated;
+	}
+
+	// Work done by the last search
+	const SearchStats& stats() const
+	{
+		return m_stats;
+	}
+
+	// Number of documents with the term, counting only the segments where
+	// it's one of the heavy keys.
+	size_t termFrequency(uint32_t term) const;
+
 	void search(const uint32_t *fingerprint, size_t length, Collector *collector);
 
+	// Search for multiple fingerprints in one pass over the index. Hits
+	// for the n-th fingerprint are passed to the n-th collector.
+	void searchMany(const std::vector<std::vector<uint32_t>> &fingerprints, const std::vector<Collector *> &collectors);
+
 	SegmentDataReader* segmentDataReader(const SegmentInfo& segment);
 
 protected:
+	// Start the timeout of a new search
+	void startSearch();
+
+	// Search the sorted terms
+	void searchTerms(std::vector<uint32_t>& terms, Collector *collector);
+	void searchTwoPhase(std::vector<uint32_t>& terms, Collector *collector);
+	void searchProbes(const std::vector<uint32_t>& terms, Collector *collector);
+	void runSearchThreads(size_t numThreads, const std::function<void(size_t)>& func);
+
+	// Searcher for the segment, which uses the block cache if the reader is
+	// opened from an index.
+	SegmentSearcher* segmentSearcher(const SegmentInfo& segment);
+
+	static size_t segmentBlocks(const SegmentInfo& segment, const uint32_t *terms, size_t length);
+
 	DirectorySharedPtr m_dir;
 	IndexInfo m_info;
 	IndexSharedPtr m_index;
+	int m_maxSearchThreads;
+	size_t m_maxTermFrequency;
+	SearchStrategy m_searchStrategy;
+	int m_sampleBits;
+	size_t m_candidateCount;
+	std::vector<uint32_t> m_probeMasks;
+	int m_timeout;
+	std::chrono::steady_clock::time_point m_deadline;
+	std::atomic<bool> m_truncated;
+	SearchStats m_stats;
+	// Query terms filtered for the segments, reused between searches
+	std::vector<uint32_t> m_segmentTerms;
 };
 
 }
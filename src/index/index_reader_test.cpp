@@ -1,6 +1,9 @@
 // Copyright (C) 2011  Lukas Lalinsky
 // Distributed under the MIT license, see the LICENSE file for details.
 
+#include <algorithm>
+#include <map>
+#include <thread>
 #include <gtest/gtest.h>
 #include "util/test_utils.h"
 #include "store/ram_directory.h"
@@ -10,6 +13,7 @@
 #include "index.h"
 #include "index_writer.h"
 #include "index_reader.h"
+#include "segment_searcher.h"
 
 using namespace Acoustid;
 
@@ -44,3 +48,518 @@ TEST(IndexReaderTest, Search)
 	}
 }
 
+TEST(IndexReaderTest, SearchStats)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	{
+		IndexWriter writer(index);
+		writer.segmentMergePolicy()->setFloorSegmentBlocks(1);
+		writer.segmentMergePolicy()->setMaxSegmentsPerTier(100);
+		uint32_t fp1[] = { 7, 9, 12 };
+		writer.addDocument(1, fp1, 3);
+		writer.commit();
+		uint32_t fp2[] = { 7, 9, 11, 13 };
+		writer.addDocument(2, fp2, 4);
+		writer.commit();
+	}
+
+	IndexReader reader(index);
+	uint32_t query[] = { 7, 9, 12 };
+	TopHitsCollector collector(100);
+	reader.search(query, 3, &collector);
+	const SearchStats& stats = reader.stats();
+	ASSERT_EQ(2, stats.segments);
+	ASSERT_LE(2, stats.lookups);
+	ASSERT_EQ(2, stats.blocks);
+	ASSERT_EQ(7, stats.items);
+	ASSERT_EQ(5, stats.hits);
+	ASSERT_EQ(2 * BLOCK_SIZE, stats.bytes);
+}
+
+
+TEST(IndexReaderTest, ParallelSearch)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	{
+		IndexWriter writer(index);
+		writer.segmentMergePolicy()->setFloorSegmentBlocks(1);
+		writer.segmentMergePolicy()->setMaxSegmentsPerTier(100);
+		for (uint32_t id = 1; id <= 10; id++) {
+			uint32_t fp[] = { 7, 9, 12 + id, 100 + id % 3 };
+			writer.addDocument(id, fp, 4);
+			writer.commit();
+		}
+	}
+
+	uint32_t query[] = { 7, 9, 14, 102 };
+
+	IndexReader serialReader(index);
+	ASSERT_EQ(10, serialReader.info().segmentCount());
+	TopHitsCollector serialCollector(100);
+	serialReader.search(query, 4, &serialCollector);
+	QList<Result> expected = serialCollector.topResults();
+
+	for (int threads = 2; threads <= 16; threads *= 2) {
+		IndexReader reader(index);
+		reader.setMaxSearchThreads(threads);
+		TopHitsCollector collector(100);
+		reader.search(query, 4, &collector);
+		QList<Result> results = collector.topResults();
+		ASSERT_EQ(expected.size(), results.size());
+		ASSERT_EQ(2, results.at(0).id());
+		ASSERT_EQ(4, results.at(0).score());
+		for (int i = 0; i < results.size(); i++) {
+			ASSERT_EQ(expected.at(i).score(), results.at(i).score());
+		}
+	}
+}
+
+TEST(IndexReaderTest, ParallelSearchOptimized)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	std::vector<uint32_t> query;
+	{
+		IndexWriter writer(index);
+		for (uint32_t id = 1; id <= 200; id++) {
+			std::vector<uint32_t> fp;
+			for (uint32_t i = 0; i < 50; i++) {
+				fp.push_back((id * 7919 + i * 104729) % 100000);
+			}
+			writer.addDocument(id, fp.data(), fp.size());
+			if (id == 123) {
+				query = fp;
+			}
+		}
+		writer.commit();
+		writer.optimize();
+		writer.commit();
+	}
+
+	IndexReader serialReader(index);
+	ASSERT_EQ(1, serialReader.info().segmentCount());
+	ASSERT_LT(10, serialReader.info().segment(0).blockCount());
+	TopHitsCollector serialCollector(1000);
+	serialReader.search(query.data(), query.size(), &serialCollector);
+	QList<Result> expected = serialCollector.topResults();
+	ASSERT_EQ(123, expected.at(0).id());
+	ASSERT_EQ(50, expected.at(0).score());
+
+	for (int threads = 2; threads <= 16; threads *= 2) {
+		IndexReader reader(index);
+		reader.setMaxSearchThreads(threads);
+		TopHitsCollector collector(1000);
+		reader.search(query.data(), query.size(), &collector);
+		QList<Result> results = collector.topResults();
+		ASSERT_EQ(expected.size(), results.size());
+		ASSERT_EQ(123, results.at(0).id());
+		for (int i = 0; i < results.size(); i++) {
+			ASSERT_EQ(expected.at(i).score(), results.at(i).score());
+		}
+		ASSERT_EQ(serialReader.stats().segments, reader.stats().segments);
+		ASSERT_EQ(serialReader.stats().hits, reader.stats().hits);
+	}
+}
+
+TEST(IndexReaderTest, SearchLargeSegment)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	std::vector<std::vector<uint32_t> > fps;
+	{
+		IndexWriter writer(index);
+		for (uint32_t id = 1; id <= 4000; id++) {
+			std::vector<uint32_t> fp;
+			for (uint32_t i = 0; i < 50; i++) {
+				fp.push_back((id * 7919 + i * 104729) % 200000);
+			}
+			writer.addDocument(id, fp.data(), fp.size());
+			fps.push_back(fp);
+		}
+		writer.commit();
+		writer.optimize();
+		writer.commit();
+	}
+
+	IndexReader reader(index);
+	ASSERT_EQ(1, reader.info().segmentCount());
+	// Large enough for the terms to be looked up ahead
+	ASSERT_LE(1024, reader.info().segment(0).blockCount());
+
+	std::vector<uint32_t> query = fps[1233];
+	std::sort(query.begin(), query.end());
+	std::map<uint32_t, int> expected;
+	for (size_t id = 1; id <= fps.size(); id++) {
+		for (size_t i = 0; i < fps[id - 1].size(); i++) {
+			if (std::binary_search(query.begin(), query.end(), fps[id - 1][i])) {
+				expected[id]++;
+			}
+		}
+	}
+
+	TopHitsCollector collector(10000);
+	reader.search(query.data(), query.size(), &collector);
+	QList<Result> results = collector.topResults();
+	ASSERT_EQ(1234, results.at(0).id());
+	ASSERT_EQ(50, results.at(0).score());
+	std::map<uint32_t, int> actual;
+	for (int i = 0; i < results.size(); i++) {
+		actual[results.at(i).id()] = results.at(i).score();
+	}
+	ASSERT_EQ(expected, actual);
+}
+
+TEST(IndexReaderTest, SearchPostings)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	{
+		IndexWriter writer(index);
+		writer.segmentMergePolicy()->setFloorSegmentBlocks(1);
+		writer.segmentMergePolicy()->setMaxSegmentsPerTier(100);
+		for (uint32_t i = 1; i <= 3000; i++) {
+			std::vector<uint32_t> fp;
+			fp.push_back(5);
+			if (i % 2) {
+				fp.push_back(6);
+			}
+			fp.push_back(1000 + i);
+			writer.addDocument(i * 37, fp.data(), fp.size());
+			if (i % 1500 == 0) {
+				writer.commit();
+			}
+		}
+	}
+
+	uint32_t query[] = { 5, 6, 1001, 1002 };
+	std::map<uint32_t, int> expected;
+	for (uint32_t i = 1; i <= 3000; i++) {
+		expected[i * 37] = 1 + (i % 2) + (i <= 2);
+	}
+
+	for (int pass = 0; pass < 2; pass++) {
+		IndexReader reader(index);
+		// Key 5 is in all documents, key 6 in half of them
+		size_t expectedPostings = pass ? 2 : 1;
+		ASSERT_EQ(pass ? 1 : 2, reader.info().segmentCount());
+		for (int i = 0; i < reader.info().segmentCount(); i++) {
+			const SegmentInfo& segment = reader.info().segment(i);
+			ASSERT_TRUE(segment.hasPostings());
+			ASSERT_EQ(expectedPostings, segment.postings()->size());
+			ASSERT_EQ(5, segment.postings()->key(0));
+		}
+
+		TopHitsCollector collector(10000);
+		reader.search(query, 4, &collector);
+		QList<Result> results = collector.topResults();
+		std::map<uint32_t, int> actual;
+		for (int i = 0; i < results.size(); i++) {
+			actual[results.at(i).id()] = results.at(i).score();
+		}
+		ASSERT_EQ(expected, actual);
+
+		IndexWriter writer(index);
+		writer.optimize();
+		writer.commit();
+	}
+}
+
+TEST(IndexReaderTest, SearchMany)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	std::vector<std::vector<uint32_t>> queries;
+	{
+		IndexWriter writer(index);
+		for (uint32_t id = 1; id <= 200; id++) {
+			std::vector<uint32_t> fp;
+			for (uint32_t i = 0; i < 50; i++) {
+				fp.push_back((id * 7919 + i * 104729) % 100000);
+			}
+			writer.addDocument(id, fp.data(), fp.size());
+			if (id % 40 == 0) {
+				writer.commit();
+				queries.push_back(fp);
+			}
+		}
+	}
+	queries.push_back(queries.front());
+	queries.push_back(std::vector<uint32_t>{ 1, 2, 3 });
+
+	IndexReader reader(index);
+	std::vector<std::unique_ptr<TopHitsCollector>> collectors;
+	std::vector<Collector *> targets;
+	for (size_t i = 0; i < queries.size(); i++) {
+		collectors.emplace_back(new TopHitsCollector(1000));
+		targets.push_back(collectors.back().get());
+	}
+	reader.searchMany(queries, targets);
+
+	for (size_t i = 0; i < queries.size(); i++) {
+		TopHitsCollector expectedCollector(1000);
+		reader.search(queries[i].data(), queries[i].size(), &expectedCollector);
+		QList<Result> expected = expectedCollector.topResults();
+		QList<Result> results = collectors[i]->topResults();
+		ASSERT_EQ(expected.size(), results.size());
+		for (int j = 0; j < results.size(); j++) {
+			ASSERT_EQ(expected.at(j).score(), results.at(j).score());
+		}
+	}
+	ASSERT_EQ(40, collectors[0]->topResults().at(0).id());
+	ASSERT_EQ(50, collectors[0]->topResults().at(0).score());
+	ASSERT_EQ(0, collectors.back()->topResults().size());
+}
+
+TEST(IndexReaderTest, SkipFrequentTerms)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	{
+		IndexWriter writer(index);
+		for (uint32_t id = 1; id <= 10; id++) {
+			uint32_t fp[] = { 7, 100 + id };
+			writer.addDocument(id, fp, 2);
+			if (id % 5 == 0) {
+				writer.commit();
+			}
+		}
+	}
+
+	IndexReader reader(index);
+	ASSERT_EQ(10, reader.termFrequency(7));
+	ASSERT_EQ(1, reader.termFrequency(103));
+
+	uint32_t query[] = { 7, 103 };
+	{
+		TopHitsCollector collector(100);
+		reader.search(query, 2, &collector);
+		ASSERT_EQ(10, collector.topResults().size());
+	}
+
+	reader.setMaxTermFrequency(5);
+	{
+		TopHitsCollector collector(100);
+		reader.search(query, 2, &collector);
+		ASSERT_EQ(1, collector.topResults().size());
+		ASSERT_EQ(3, collector.topResults().at(0).id());
+		ASSERT_EQ(1, collector.topResults().at(0).score());
+	}
+
+	// Frequent probes are skipped as well, 6 ^ 1 is 7 and 103 ^ 1 is 102
+	std::vector<uint32_t> masks = { 1 };
+	reader.setProbeMasks(masks);
+	uint32_t query2[] = { 6, 103 };
+	{
+		TopHitsCollector collector(100);
+		reader.search(query2, 2, &collector);
+		QList<Result> results = collector.topResults();
+		ASSERT_EQ(2, results.size());
+		ASSERT_EQ(1, results.at(0).score());
+		ASSERT_EQ(1, results.at(1).score());
+	}
+}
+
+TEST(IndexReaderTest, TwoPhaseSearch)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	{
+		IndexWriter writer(index);
+		for (uint32_t id = 1; id <= 20; id++) {
+			std::vector<uint32_t> fp;
+			for (uint32_t i = 0; i < 100; i++) {
+				fp.push_back(i * 1000 + (i < id * 5 ? 0 : id));
+			}
+			writer.addDocument(id, fp.data(), fp.size());
+		}
+		writer.commit();
+	}
+
+	std::vector<uint32_t> query;
+	for (uint32_t i = 0; i < 100; i++) {
+		query.push_back(i * 1000);
+	}
+
+	IndexReader reader(index);
+	TopHitsCollector exactCollector(5);
+	reader.search(query.data(), query.size(), &exactCollector);
+	QList<Result> expected = exactCollector.topResults();
+
+	reader.setSearchStrategy(IndexReader::TwoPhaseSearch);
+	reader.setSampleBits(2);
+	reader.setCandidateCount(10);
+	size_t sampled = 0;
+	for (size_t i = 0; i < query.size(); i++) {
+		sampled += reader.isSampledTerm(query[i]) ? 1 : 0;
+	}
+	ASSERT_GT(sampled, 0);
+	ASSERT_LT(sampled, query.size());
+
+	TopHitsCollector collector(5);
+	reader.search(query.data(), query.size(), &collector);
+	QList<Result> results = collector.topResults();
+	ASSERT_EQ(expected.size(), results.size());
+	for (int i = 0; i < expected.size(); i++) {
+		ASSERT_EQ(expected.at(i).id(), results.at(i).id());
+		ASSERT_EQ(expected.at(i).score(), results.at(i).score());
+	}
+}
+
+TEST(IndexReaderTest, SearchProbes)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	{
+		IndexWriter writer(index);
+		uint32_t fp1[] = { 0x100, 0x200, 0x300, 0x400 };
+		writer.addDocument(1, fp1, 4);
+		// Two terms with one flipped bit, one term matching both a query term and its probe
+		uint32_t fp2[] = { 0x101, 0x200, 0x201, 0x302 };
+		writer.addDocument(2, fp2, 4);
+		writer.commit();
+	}
+
+	uint32_t query[] = { 0x100, 0x200, 0x300, 0x400 };
+	IndexReader reader(index);
+	{
+		TopHitsCollector collector(10);
+		reader.search(query, 4, &collector);
+		QList<Result> results = collector.topResults();
+		ASSERT_EQ(2, results.size());
+		ASSERT_EQ(1, results.at(0).id());
+		ASSERT_EQ(4, results.at(0).score());
+		ASSERT_EQ(2, results.at(1).id());
+		ASSERT_EQ(1, results.at(1).score());
+	}
+
+	std::vector<uint32_t> masks = { 1, 2 };
+	reader.setProbeMasks(masks);
+	{
+		TopHitsCollector collector(10);
+		reader.search(query, 4, &collector);
+		QList<Result> results = collector.topResults();
+		ASSERT_EQ(2, results.size());
+		ASSERT_EQ(1, results.at(0).id());
+		ASSERT_EQ(4, results.at(0).score());
+		ASSERT_EQ(2, results.at(1).id());
+		ASSERT_EQ(3, results.at(1).score());
+	}
+
+	// Probes are combined with the other search settings
+	reader.setMaxSearchThreads(2);
+	reader.setSearchStrategy(IndexReader::TwoPhaseSearch);
+	reader.setSampleBits(0);
+	{
+		TopHitsCollector collector(10);
+		reader.search(query, 4, &collector);
+		QList<Result> results = collector.topResults();
+		ASSERT_EQ(2, results.size());
+		ASSERT_EQ(1, results.at(0).id());
+		ASSERT_EQ(4, results.at(0).score());
+		ASSERT_EQ(2, results.at(1).id());
+		ASSERT_EQ(3, results.at(1).score());
+	}
+}
+
+TEST(IndexReaderTest, SearchDeadline)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	{
+		IndexWriter writer(index);
+		uint32_t fp[] = { 7, 9, 12 };
+		writer.addDocument(1, fp, 3);
+		writer.commit();
+	}
+
+	uint32_t query[] = { 7, 9, 12 };
+	IndexReader reader(index);
+	reader.setTimeout(60000);
+	{
+		TopHitsCollector collector(10);
+		reader.search(query, 3, &collector);
+		ASSERT_FALSE(reader.isTruncated());
+		ASSERT_EQ(1, collector.topResults().size());
+		ASSERT_EQ(3, collector.topResults().at(0).score());
+	}
+
+	const SegmentInfo& segment = reader.info().segment(0);
+	{
+		SegmentSearcher searcher(segment.index(), reader.segmentDataReader(segment), segment.lastKey());
+		searcher.setDeadline(SegmentSearcher::Clock::now() - std::chrono::seconds(1));
+		TopHitsCollector collector(10);
+		searcher.search(query, 3, &collector);
+		ASSERT_TRUE(searcher.isTruncated());
+		ASSERT_EQ(0, collector.topResults().size());
+	}
+	{
+		SegmentSearcher searcher(segment.index(), reader.segmentDataReader(segment), segment.lastKey());
+		searcher.setDeadline(SegmentSearcher::Clock::now() + std::chrono::hours(1));
+		TopHitsCollector collector(10);
+		searcher.search(query, 3, &collector);
+		ASSERT_FALSE(searcher.isTruncated());
+		ASSERT_EQ(1, collector.topResults().size());
+	}
+}
+
+// Waits for the deadline on the first hit
+class SlowCollector : public Collector
+{
+public:
+	SlowCollector(SegmentSearcher::Clock::time_point deadline) : m_deadline(deadline), m_count(0) { }
+
+	void collect(uint32_t)
+	{
+		if (!m_count++) {
+			std::this_thread::sleep_until(m_deadline + std::chrono::milliseconds(1));
+		}
+	}
+
+	size_t count() const { return m_count; }
+
+private:
+	SegmentSearcher::Clock::time_point m_deadline;
+	size_t m_count;
+};
+
+TEST(IndexReaderTest, SearchDeadlinePostings)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	{
+		IndexWriter writer(index);
+		for (uint32_t i = 1; i <= 1500; i++) {
+			uint32_t fp[] = { 5, 6, 1000 + i };
+			writer.addDocument(i, fp, 3);
+		}
+		writer.commit();
+	}
+
+	uint32_t query[] = { 5, 6, 1001 };
+	IndexReader reader(index);
+	const SegmentInfo& segment = reader.info().segment(0);
+	ASSERT_EQ(2, segment.postings()->size());
+
+	// The deadline passes while the first posting list is read
+	SegmentSearcher searcher(segment.index(), reader.segmentDataReader(segment), segment.lastKey());
+	searcher.setPostings(segment.postings());
+	SegmentSearcher::Clock::time_point deadline = SegmentSearcher::Clock::now() + std::chrono::milliseconds(50);
+	searcher.setDeadline(deadline);
+	SlowCollector collector(deadline);
+	searcher.search(query, 3, &collector);
+	ASSERT_TRUE(searcher.isTruncated());
+	ASSERT_EQ(1500, collector.count());
+}
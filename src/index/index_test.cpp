@@ -41,3 +41,89 @@ TEST(IndexTest, DeleteUnusedFiled)
 	ASSERT_TRUE(index->directory()->fileExists("info_1"));
 	ASSERT_FALSE(index->directory()->fileExists("info_0"));
 }
+
+TEST(IndexTest, KeepSegmentsUsedBySnapshot)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	uint32_t fp[] = { 1, 2, 3 };
+	{
+		std::unique_ptr<IndexWriter> writer(new IndexWriter(index));
+		writer->addDocument(1, fp, 3);
+		writer->commit();
+	}
+	ASSERT_TRUE(dir->fileExists("segment_0.fid"));
+
+	std::unique_ptr<IndexReader> reader(new IndexReader(index));
+	{
+		std::unique_ptr<IndexWriter> writer(new IndexWriter(index));
+		writer->addDocument(2, fp, 3);
+		writer->optimize();
+		writer->commit();
+	}
+	ASSERT_EQ(1, index->info().segmentCount());
+	ASSERT_FALSE(dir->fileExists("segment_1.fid"));
+	ASSERT_TRUE(dir->fileExists("segment_0.fii"));
+	ASSERT_TRUE(dir->fileExists("segment_0.fid"));
+
+	reader.reset();
+	ASSERT_FALSE(dir->fileExists("segment_0.fii"));
+	ASSERT_FALSE(dir->fileExists("segment_0.fid"));
+	ASSERT_TRUE(dir->fileExists(index->info().segment(0).dataFileName()));
+}
+
+TEST(IndexTest, KeepSegmentsUsedBySnapshotAfterIndexIsGone)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	uint32_t fp[] = { 1, 2, 3 };
+	{
+		std::unique_ptr<IndexWriter> writer(new IndexWriter(index));
+		writer->addDocument(1, fp, 3);
+		writer->commit();
+	}
+
+	IndexInfo snapshot = index->info();
+	{
+		std::unique_ptr<IndexWriter> writer(new IndexWriter(index));
+		writer->addDocument(2, fp, 3);
+		writer->optimize();
+		writer->commit();
+	}
+	QString fileName = index->info().segment(0).dataFileName();
+
+	// The snapshot keeps the directory alive to delete the files later
+	QWeakPointer<Directory> weakDir = dir;
+	index.clear();
+	dir.clear();
+	ASSERT_FALSE(weakDir.isNull());
+
+	dir = weakDir.toStrongRef();
+	ASSERT_TRUE(dir->fileExists("segment_0.fid"));
+	snapshot = IndexInfo();
+	ASSERT_FALSE(dir->fileExists("segment_0.fid"));
+	ASSERT_TRUE(dir->fileExists(fileName));
+}
+
+TEST(IndexTest, DeleteUncommittedSegments)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+	IndexSharedPtr index(new Index(dir, true));
+
+	QString fileName;
+	{
+		std::unique_ptr<IndexWriter> writer(new IndexWriter(index));
+		uint32_t fp[] = { 1, 2, 3 };
+		writer->addDocument(1, fp, 3);
+		writer->optimize();
+		ASSERT_EQ(1, writer->info().segmentCount());
+		fileName = writer->info().segment(0).dataFileName();
+		ASSERT_TRUE(dir->fileExists(fileName));
+	}
+	ASSERT_FALSE(dir->fileExists(fileName));
+	ASSERT_FALSE(dir->fileExists("segment_0.fid"));
+	ASSERT_TRUE(dir->fileExists("info_0"));
+	ASSERT_EQ(0, index->info().segmentCount());
+}
@@ -11,7 +11,6 @@
 #include "segment_data_reader.h"
 #include "segment_merger.h"
 #include "index.h"
-#include "index_file_deleter.h"
 #include "index_utils.h"
 #include "index_writer.h"
 
@@ -33,10 +32,28 @@ IndexWriter::IndexWriter(IndexSharedPtr index)
 IndexWriter::~IndexWriter()
 {
 	if (m_index) {
+		removeUncommittedSegments(m_info.segments());
 		m_index->releaseWriterLock();
 	}
 }
 
+// Segments that were never committed are not in any snapshot of the
+// index, so their files can go as soon as the writer drops them.
+void IndexWriter::removeUncommittedSegments(const SegmentInfoList& segments)
+{
+	const IndexInfo& committed = m_index->info();
+	QSet<int> committedIds;
+	for (int i = 0; i < committed.segmentCount(); i++) {
+		committedIds.insert(committed.segment(i).id());
+	}
+	for (int i = 0; i < segments.size(); i++) {
+		const SegmentInfo& segment = segments.at(i);
+		if (!committedIds.contains(segment.id()) && segment.fileRef()) {
+			segment.fileRef()->markObsolete();
+		}
+	}
+}
+
 void IndexWriter::addDocument(uint32_t id, const uint32_t *terms, size_t length)
 {
 	for (size_t i = 0; i < length; i++) {
@@ -59,7 +76,7 @@ void IndexWriter::commit()
 	IndexInfo info(m_info);
 	info.save(m_dir.data());
 	if (m_index) {
-		m_index->updateInfo(m_info, info, true);
+		m_index->updateInfo(info);
 	}
 	m_info = info;
 	qDebug() << "Committed revision" << m_info.revision() << m_info.segments().size();
@@ -77,7 +94,54 @@ SegmentDataWriter* IndexWriter::segmentDataWriter(const SegmentInfo& segment)
 	OutputStream* indexOutput = m_dir->createFile(segment.indexFileName());
 	OutputStream* dataOutput = m_dir->createFile(segment.dataFileName());
 	SegmentIndexWriter* indexWriter = new SegmentIndexWriter(indexOutput);
-	return new SegmentDataWriter(dataOutput, indexWriter, BLOCK_SIZE);
+	SegmentDataWriter* writer = new SegmentDataWriter(dataOutput, indexWriter, BLOCK_SIZE, segment.version());
+	writer->setMaxFilterKeys(MAX_SEGMENT_FILTER_KEYS);
+	writer->setMaxHeavyKeys(MAX_SEGMENT_HEAVY_KEYS);
+	writer->setMinPostingListSize(MIN_SEGMENT_POSTING_LIST_SIZE);
+	return writer;
+}
+
+void IndexWriter::writeSegmentFilter(SegmentInfo& segment, SegmentDataWriter* writer)
+{
+	SegmentFilterSharedPtr filter = writer->filter();
+	if (!filter) {
+		return;
+	}
+	std::unique_ptr<OutputStream> output(m_dir->createFile(segment.filterFileName()));
+	filter->save(output.get());
+	segment.setHasFilter(true);
+	segment.setFilter(filter);
+}
+
+void IndexWriter::writeSegmentHeavyKeys(SegmentInfo& segment, SegmentDataWriter* writer)
+{
+	SegmentHeavyKeysSharedPtr heavyKeys = writer->heavyKeys();
+	if (!heavyKeys) {
+		return;
+	}
+	std::unique_ptr<OutputStream> output(m_dir->createFile(segment.heavyKeysFileName()));
+	heavyKeys->save(output.get());
+	segment.setHasHeavyKeys(true);
+	segment.setHeavyKeys(heavyKeys);
+}
+
+void IndexWriter::writeSegmentPostings(SegmentInfo& segment, SegmentDataWriter* writer)
+{
+	SegmentPostingsSharedPtr postings = writer->postings();
+	if (!postings) {
+		return;
+	}
+	std::unique_ptr<OutputStream> output(m_dir->createFile(segment.postingsFileName()));
+	postings->save(output.get());
+	segment.setHasPostings(true);
+	segment.setPostings(postings);
+}
+
+void IndexWriter::addSegment(IndexInfo& info, SegmentInfo& segment)
+{
+	segment.setDataFile(m_dir->openInputFile(segment.dataFileName()));
+	segment.setFileRef(SegmentFileRefSharedPtr(new SegmentFileRef(m_dir, segment.files())));
+	info.addSegment(segment);
 }
 
 void IndexWriter::merge(const QList<int>& merge)
@@ -97,13 +161,16 @@ void IndexWriter::merge(const QList<int>& merge)
 			const SegmentInfo& s = segments.at(j);
 			expectedChecksum ^= s.checksum();
 			qDebug() << "Merging segment" << s.id() << "with checksum" << s.checksum() << "into segment" << segment.id();
-			merger.addSource(new SegmentEnum(s.index(), segmentDataReader(s)));
+			merger.addSource(new SegmentEnum(s.index(), segmentDataReader(s), s.postings()));
 		}
 		merger.merge();
 		segment.setBlockCount(merger.writer()->blockCount());
 		segment.setLastKey(merger.writer()->lastKey());
 		segment.setChecksum(merger.writer()->checksum());
 		segment.setIndex(merger.writer()->index());
+		writeSegmentFilter(segment, merger.writer());
+		writeSegmentHeavyKeys(segment, merger.writer());
+		writeSegmentPostings(segment, merger.writer());
 	}
 
 	qDebug() << "New segment" << segment.id() << "with checksum" << segment.checksum() << "(merge)";
@@ -113,16 +180,20 @@ void IndexWriter::merge(const QList<int>& merge)
 	}
 
 	QSet<int> merged = merge.toSet();
+	SegmentInfoList mergedSegments;
 	info.clearSegments();
 	for (size_t i = 0; i < segments.size(); i++) {
 		const SegmentInfo& s = segments.at(i);
 		if (!merged.contains(i)) {
 			info.addSegment(s);
 		}
+		else {
+			mergedSegments.append(s);
+		}
 	}
-	info.addSegment(segment);
+	addSegment(info, segment);
 	if (m_index) {
-		m_index->updateInfo(m_info, info);
+		removeUncommittedSegments(mergedSegments);
 	}
 	m_info = info;
 }
@@ -159,16 +230,16 @@ void IndexWriter::flush()
 		segment.setLastKey(writer->lastKey());
 		segment.setChecksum(writer->checksum());
 		segment.setIndex(writer->index());
+		writeSegmentFilter(segment, writer.get());
+		writeSegmentHeavyKeys(segment, writer.get());
+		writeSegmentPostings(segment, writer.get());
 	}
 
 	qDebug() << "New segment" << segment.id() << "with checksum" << segment.checksum();
-	info.addSegment(segment);
+	addSegment(info, segment);
 	if (info.attribute("max_document_id").toInt() < m_maxDocumentId) {
 		info.setAttribute("max_document_id", QString::number(m_maxDocumentId));
 	}
-	if (m_index) {
-		m_index->updateInfo(m_info, info);
-	}
 	m_info = info;
 
 	maybeMerge();
@@ -195,9 +266,10 @@ void IndexWriter::cleanup()
 	usedFileNames.insert(m_info.indexInfoFileName(m_info.revision()));
 	const SegmentInfoList& segments = m_info.segments();
 	for (int i = 0; i < segments.size(); i++) {
-		const SegmentInfo& segment = segments.at(i);
-		usedFileNames.insert(segment.indexFileName());
-		usedFileNames.insert(segment.dataFileName());
+		const QList<QString>& files = segments.at(i).files();
+		for (int j = 0; j < files.size(); j++) {
+			usedFileNames.insert(files.at(j));
+		}
 	}
 
 	QList<QString> allFileNames = m_dir->listFiles();
@@ -50,6 +50,11 @@ private:
 	void merge(const QList<int>& merge);
 
 	SegmentDataWriter *segmentDataWriter(const SegmentInfo& info);
+	void writeSegmentFilter(SegmentInfo& segment, SegmentDataWriter *writer);
+	void writeSegmentHeavyKeys(SegmentInfo& segment, SegmentDataWriter *writer);
+	void writeSegmentPostings(SegmentInfo& segment, SegmentDataWriter *writer);
+	void addSegment(IndexInfo& info, SegmentInfo& segment);
+	void removeUncommittedSegments(const SegmentInfoList& segments);
 
 	uint32_t m_maxDocumentId;
 	size_t m_maxSegmentBufferSize;
@@ -6,6 +6,9 @@
 #include "store/ram_directory.h"
 #include "store/input_stream.h"
 #include "store/output_stream.h"
+#include "segment_data_writer.h"
+#include "segment_index_writer.h"
+#include "top_hits_collector.h"
 #include "index_writer.h"
 #include "index.h"
 
@@ -28,12 +31,19 @@ TEST(IndexWriterTest, AddDocument)
 	ASSERT_TRUE(index->directory()->fileExists("info_1"));
 	ASSERT_TRUE(index->directory()->fileExists("segment_0.fii"));
 	ASSERT_TRUE(index->directory()->fileExists("segment_0.fid"));
+	ASSERT_TRUE(index->directory()->fileExists("segment_0.fif"));
+	ASSERT_TRUE(index->directory()->fileExists("segment_0.fih"));
 	ASSERT_EQ(1, writer->info().revision());
 	ASSERT_EQ(1, writer->info().segmentCount());
 	ASSERT_EQ("1", writer->info().attribute("max_document_id"));
 	ASSERT_EQ("segment_0", writer->info().segment(0).name());
 	ASSERT_EQ(1, writer->info().segment(0).blockCount());
 	ASSERT_EQ(3, writer->info().segment(0).checksum());
+	ASSERT_EQ(SEGMENT_FORMAT_V3, writer->info().segment(0).version());
+	ASSERT_TRUE(writer->info().segment(0).hasFilter());
+	ASSERT_TRUE(writer->info().segment(0).mayContain(9));
+	ASSERT_TRUE(writer->info().segment(0).hasHeavyKeys());
+	ASSERT_EQ(1, writer->info().segment(0).keyFrequency(9));
 
 	{
 		std::unique_ptr<InputStream> input(index->directory()->openFile("segment_0.fii"));
@@ -43,11 +53,13 @@ TEST(IndexWriterTest, AddDocument)
 	{
 		std::unique_ptr<InputStream> input(index->directory()->openFile("segment_0.fid"));
 		ASSERT_EQ(3, input->readInt16());
-		ASSERT_EQ(1, input->readVInt32());
-		ASSERT_EQ(2, input->readVInt32());
-		ASSERT_EQ(1, input->readVInt32());
-		ASSERT_EQ(3, input->readVInt32());
-		ASSERT_EQ(1, input->readVInt32());
+		ASSERT_EQ(0x00, input->readByte());
+		ASSERT_EQ(2, input->readByte());
+		ASSERT_EQ(3, input->readByte());
+		ASSERT_EQ(0x00, input->readByte());
+		ASSERT_EQ(1, input->readByte());
+		ASSERT_EQ(1, input->readByte());
+		ASSERT_EQ(1, input->readByte());
 	}
 }
 
@@ -73,7 +85,7 @@ TEST(IndexWriterTest, Merge)
 	ASSERT_EQ(1, writer->info().segment(0).blockCount());
 	writer.reset(NULL);
 	writer.reset(new IndexWriter(index));
-	ASSERT_EQ(3, index->directory()->listFiles().size());
+	ASSERT_EQ(5, index->directory()->listFiles().size());
 	qDebug() << index->directory()->listFiles();
 	writer->segmentMergePolicy()->setMaxMergeAtOnce(2);
 	writer->segmentMergePolicy()->setMaxSegmentsPerTier(2);
@@ -85,7 +97,7 @@ TEST(IndexWriterTest, Merge)
 	ASSERT_EQ(1, writer->info().segment(1).blockCount());
 	writer.reset(NULL);
 	writer.reset(new IndexWriter(index));
-	ASSERT_EQ(5, index->directory()->listFiles().size());
+	ASSERT_EQ(9, index->directory()->listFiles().size());
 	qDebug() << index->directory()->listFiles();
 	writer->segmentMergePolicy()->setMaxMergeAtOnce(2);
 	writer->segmentMergePolicy()->setMaxSegmentsPerTier(2);
@@ -98,7 +110,7 @@ TEST(IndexWriterTest, Merge)
 	ASSERT_EQ(1, writer->info().segment(1).blockCount());
 	writer.reset(NULL);
 	writer.reset(new IndexWriter(index));
-	ASSERT_EQ(5, index->directory()->listFiles().size());
+	ASSERT_EQ(9, index->directory()->listFiles().size());
 	qDebug() << index->directory()->listFiles();
 	writer->segmentMergePolicy()->setMaxMergeAtOnce(2);
 	writer->segmentMergePolicy()->setMaxSegmentsPerTier(2);
@@ -110,7 +122,7 @@ TEST(IndexWriterTest, Merge)
 	ASSERT_EQ(1, writer->info().segment(1).blockCount());
 	writer.reset(NULL);
 	writer.reset(new IndexWriter(index));
-	ASSERT_EQ(5, index->directory()->listFiles().size());
+	ASSERT_EQ(9, index->directory()->listFiles().size());
 	qDebug() << index->directory()->listFiles();
 	writer->segmentMergePolicy()->setMaxMergeAtOnce(3);
 	writer->segmentMergePolicy()->setMaxSegmentsPerTier(1);
@@ -120,7 +132,53 @@ TEST(IndexWriterTest, Merge)
 	ASSERT_EQ(1, writer->info().segmentCount());
 	ASSERT_EQ(1, writer->info().segment(0).blockCount());
 	writer.reset(NULL);
-	ASSERT_EQ(3, index->directory()->listFiles().size());
+	ASSERT_EQ(5, index->directory()->listFiles().size());
 	qDebug() << index->directory()->listFiles();
 }
 
+
+TEST(IndexWriterTest, MergeV1Segment)
+{
+	DirectorySharedPtr dir(new RAMDirectory());
+
+	{
+		IndexInfo info;
+		SegmentInfo segment(info.incLastSegmentId());
+		segment.setVersion(SEGMENT_FORMAT_V1);
+		SegmentIndexWriter *indexWriter = new SegmentIndexWriter(dir->createFile(segment.indexFileName()));
+		SegmentDataWriter writer(dir->createFile(segment.dataFileName()), indexWriter, BLOCK_SIZE, SEGMENT_FORMAT_V1);
+		writer.addItem(7, 1);
+		writer.addItem(9, 1);
+		writer.addItem(12, 1);
+		writer.close();
+		segment.setBlockCount(writer.blockCount());
+		segment.setLastKey(writer.lastKey());
+		segment.setChecksum(writer.checksum());
+		info.addSegment(segment);
+		info.save(dir.data());
+	}
+
+	IndexSharedPtr index(new Index(dir));
+	ASSERT_EQ(SEGMENT_FORMAT_V1, index->info().segment(0).version());
+
+	uint32_t fp[] = { 7, 9, 11 };
+	{
+		std::unique_ptr<IndexWriter> writer(new IndexWriter(index));
+		writer->addDocument(2, fp, 3);
+		writer->optimize();
+		writer->commit();
+		ASSERT_EQ(1, writer->info().segmentCount());
+		ASSERT_EQ(SEGMENT_FORMAT_V3, writer->info().segment(0).version());
+	}
+
+	{
+		IndexReader reader(index);
+		TopHitsCollector collector(100);
+		reader.search(fp, 3, &collector);
+		ASSERT_EQ(2, collector.topResults().size());
+		ASSERT_EQ(2, collector.topResults().at(0).id());
+		ASSERT_EQ(3, collector.topResults().at(0).score());
+		ASSERT_EQ(1, collector.topResults().at(1).id());
+		ASSERT_EQ(2, collector.topResults().at(1).score());
+	}
+}
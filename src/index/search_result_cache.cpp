@@ -0,0 +1,114 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include "search_result_cache.h"
+
+using namespace Acoustid;
+
+SearchResultCache::SearchResultCache(size_t maxSize, int ttl)
+	: m_maxSize(maxSize), m_ttl(ttl), m_revision(-1)
+{
+}
+
+SearchResultCache::~SearchResultCache()
+{
+}
+
+void SearchResultCache::setMaxSize(size_t maxSize)
+{
+	QMutexLocker locker(&m_mutex);
+	m_maxSize = maxSize;
+	while (m_entries.size() > m_maxSize) {
+		remove(--m_entries.end());
+	}
+}
+
+size_t SearchResultCache::size()
+{
+	QMutexLocker locker(&m_mutex);
+	return m_entries.size();
+}
+
+void SearchResultCache::clear()
+{
+	QMutexLocker locker(&m_mutex);
+	m_entries.clear();
+	m_positions.clear();
+}
+
+// FNV-1a over the terms and the settings
+uint64_t SearchResultCache::hash(const std::vector<uint32_t> &terms, const SearchSettings &settings)
+{
+	uint64_t hash = UINT64_C(14695981039346656037);
+	hash = (hash ^ uint32_t(settings.maxResults)) * UINT64_C(1099511628211);
+	hash = (hash ^ uint32_t(settings.topScorePercent)) * UINT64_C(1099511628211);
+	hash = (hash ^ uint64_t(settings.maxTermFrequency)) * UINT64_C(1099511628211);
+	hash = (hash ^ uint32_t(settings.searchStrategy)) * UINT64_C(1099511628211);
+	for (size_t i = 0; i < settings.probeMasks.size(); i++) {
+		hash = (hash ^ settings.probeMasks[i]) * UINT64_C(1099511628211);
+	}
+	for (size_t i = 0; i < terms.size(); i++) {
+		hash = (hash ^ terms[i]) * UINT64_C(1099511628211);
+	}
+	return hash;
+}
+
+// Drop all entries if there is a new revision. Returns false for
+// searches in an older revision, whose results can't be cached.
+bool SearchResultCache::updateRevision(int revision)
+{
+	if (revision > m_revision) {
+		m_entries.clear();
+		m_positions.clear();
+		m_revision = revision;
+	}
+	return revision == m_revision;
+}
+
+void SearchResultCache::remove(EntryList::iterator entry)
+{
+	m_positions.remove(entry->hash);
+	m_entries.erase(entry);
+}
+
+bool SearchResultCache::find(int revision, const std::vector<uint32_t> &terms, const SearchSettings &settings, QList<Result> *results)
+{
+	QMutexLocker locker(&m_mutex);
+	if (!m_maxSize || !updateRevision(revision)) {
+		return false;
+	}
+	uint64_t key = hash(terms, settings);
+	if (!m_positions.contains(key)) {
+		return false;
+	}
+	EntryList::iterator entry = m_positions.value(key);
+	if (entry->terms != terms || entry->settings != settings) {
+		// Hash collision
+		return false;
+	}
+	if (m_ttl > 0 && Clock::now() - entry->time > std::chrono::seconds(m_ttl)) {
+		remove(entry);
+		return false;
+	}
+	m_entries.splice(m_entries.begin(), m_entries, entry);
+	*results = entry->results;
+	return true;
+}
+
+void SearchResultCache::insert(int revision, const std::vector<uint32_t> &terms, const SearchSettings &settings, const QList<Result> &results)
+{
+	QMutexLocker locker(&m_mutex);
+	if (!m_maxSize || !updateRevision(revision)) {
+		return;
+	}
+	uint64_t key = hash(terms, settings);
+	if (m_positions.contains(key)) {
+		remove(m_positions.value(key));
+	}
+	while (m_entries.size() >= m_maxSize) {
+		remove(--m_entries.end());
+	}
+	Entry entry = { key, terms, settings, Clock::now(), results };
+	m_entries.push_front(entry);
+	m_positions.insert(key, m_entries.begin());
+}
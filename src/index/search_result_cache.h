@@ -0,0 +1,102 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_INDEX_SEARCH_RESULT_CACHE_H_
+#define ACOUSTID_INDEX_SEARCH_RESULT_CACHE_H_
+
+#include <chrono>
+#include <list>
+#include <vector>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include "common.h"
+#include "top_hits_collector.h"
+
+namespace Acoustid {
+
+// Search settings that affect the results
+struct SearchSettings
+{
+	SearchSettings(int maxResults = 0, int topScorePercent = 0, size_t maxTermFrequency = 0, int searchStrategy = 0)
+		: maxResults(maxResults), topScorePercent(topScorePercent), maxTermFrequency(maxTermFrequency),
+		  searchStrategy(searchStrategy) { }
+
+	bool operator==(const SearchSettings &other) const
+	{
+		return maxResults == other.maxResults && topScorePercent == other.topScorePercent &&
+			maxTermFrequency == other.maxTermFrequency && searchStrategy == other.searchStrategy &&
+			probeMasks == other.probeMasks;
+	}
+
+	bool operator!=(const SearchSettings &other) const
+	{
+		return !(*this == other);
+	}
+
+	int maxResults;
+	int topScorePercent;
+	size_t maxTermFrequency;
+	int searchStrategy;
+	std::vector<uint32_t> probeMasks;
+};
+
+// LRU cache of search results. Results are only valid for the index
+// revision they were found in, an entry from an older revision is never
+// returned. The cache is disabled if the maximum size is zero.
+class SearchResultCache
+{
+public:
+	SearchResultCache(size_t maxSize = 0, int ttl = 0);
+	~SearchResultCache();
+
+	// Maximum number of cached searches
+	size_t maxSize() const { return m_maxSize; }
+	void setMaxSize(size_t maxSize);
+
+	// Number of seconds the results are valid for, zero means forever
+	int ttl() const { return m_ttl; }
+	void setTtl(int ttl) { m_ttl = ttl; }
+
+	bool isEnabled() const { return m_maxSize > 0; }
+
+	// The terms must be sorted.
+	bool find(int revision, const std::vector<uint32_t> &terms, const SearchSettings &settings, QList<Result> *results);
+	void insert(int revision, const std::vector<uint32_t> &terms, const SearchSettings &settings, const QList<Result> &results);
+
+	void clear();
+	size_t size();
+
+private:
+	ACOUSTID_DISABLE_COPY(SearchResultCache);
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry
+	{
+		uint64_t hash;
+		std::vector<uint32_t> terms;
+		SearchSettings settings;
+		Clock::time_point time;
+		QList<Result> results;
+	};
+
+	typedef std::list<Entry> EntryList;
+
+	static uint64_t hash(const std::vector<uint32_t> &terms, const SearchSettings &settings);
+	void remove(EntryList::iterator entry);
+	bool updateRevision(int revision);
+
+	QMutex m_mutex;
+	size_t m_maxSize;
+	int m_ttl;
+	// Newest revision seen, all entries are from it
+	int m_revision;
+	// Most recently used first
+	EntryList m_entries;
+	QHash<uint64_t, EntryList::iterator> m_positions;
+};
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <gtest/gtest.h>
+#include "util/test_utils.h"
+#include "search_result_cache.h"
+
+using namespace Acoustid;
+
+TEST(SearchResultCacheTest, Disabled)
+{
+	SearchResultCache cache;
+	std::vector<uint32_t> terms = { 1, 2, 3 };
+	QList<Result> results;
+	results.append(Result(1, 3));
+	cache.insert(1, terms, SearchSettings(10, 10), results);
+	ASSERT_FALSE(cache.find(1, terms, SearchSettings(10, 10), &results));
+	ASSERT_EQ(0, cache.size());
+}
+
+TEST(SearchResultCacheTest, FindAndInsert)
+{
+	SearchResultCache cache(10);
+	std::vector<uint32_t> terms = { 1, 2, 3 };
+	QList<Result> results, found;
+	results.append(Result(1, 3));
+	results.append(Result(2, 1));
+
+	ASSERT_FALSE(cache.find(1, terms, SearchSettings(10, 10), &found));
+	cache.insert(1, terms, SearchSettings(10, 10), results);
+	ASSERT_TRUE(cache.find(1, terms, SearchSettings(10, 10), &found));
+	ASSERT_EQ(2, found.size());
+	ASSERT_EQ(1, found[0].id());
+	ASSERT_EQ(2, found[1].id());
+
+	// Different settings or terms
+	ASSERT_FALSE(cache.find(1, terms, SearchSettings(1, 10), &found));
+	ASSERT_FALSE(cache.find(1, terms, SearchSettings(10, 50), &found));
+	ASSERT_FALSE(cache.find(1, terms, SearchSettings(10, 10, 1000), &found));
+	ASSERT_FALSE(cache.find(1, terms, SearchSettings(10, 10, 0, 1), &found));
+	SearchSettings probeSettings(10, 10);
+	probeSettings.probeMasks.push_back(1);
+	ASSERT_FALSE(cache.find(1, terms, probeSettings, &found));
+	ASSERT_FALSE(cache.find(1, { 1, 2, 4 }, SearchSettings(10, 10), &found));
+
+	// Old revision can't use or replace the new results
+	ASSERT_FALSE(cache.find(0, terms, SearchSettings(10, 10), &found));
+	ASSERT_TRUE(cache.find(1, terms, SearchSettings(10, 10), &found));
+
+	// New revision invalidates everything
+	ASSERT_FALSE(cache.find(2, terms, SearchSettings(10, 10), &found));
+	ASSERT_EQ(0, cache.size());
+}
+
+TEST(SearchResultCacheTest, Evict)
+{
+	SearchResultCache cache(2);
+	QList<Result> results, found;
+	cache.insert(1, { 1 }, SearchSettings(10, 10), results);
+	cache.insert(1, { 2 }, SearchSettings(10, 10), results);
+	ASSERT_TRUE(cache.find(1, { 1 }, SearchSettings(10, 10), &found));
+	cache.insert(1, { 3 }, SearchSettings(10, 10), results);
+	ASSERT_EQ(2, cache.size());
+	ASSERT_TRUE(cache.find(1, { 1 }, SearchSettings(10, 10), &found));
+	ASSERT_FALSE(cache.find(1, { 2 }, SearchSettings(10, 10), &found));
+	ASSERT_TRUE(cache.find(1, { 3 }, SearchSettings(10, 10), &found));
+
+	cache.setMaxSize(1);
+	ASSERT_EQ(1, cache.size());
+	ASSERT_TRUE(cache.find(1, { 3 }, SearchSettings(10, 10), &found));
+}
@@ -0,0 +1,40 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_INDEX_SEARCH_STATS_H_
+#define ACOUSTID_INDEX_SEARCH_STATS_H_
+
+#include "common.h"
+
+namespace Acoustid {
+
+// Work done by one search
+struct SearchStats
+{
+	// Segments searched, a segment searched in several parts counts once
+	size_t segments { 0 };
+	// Lookups in the segment indexes
+	size_t lookups { 0 };
+	// Blocks decoded, including the ones found in the block cache
+	size_t blocks { 0 };
+	// Items of the decoded blocks
+	size_t items { 0 };
+	// Items matching a term
+	size_t hits { 0 };
+	// Size of the block data decoded
+	size_t bytes { 0 };
+
+	void add(const SearchStats &other)
+	{
+		segments += other.segments;
+		lookups += other.lookups;
+		blocks += other.blocks;
+		items += other.items;
+		hits += other.hits;
+		bytes += other.bytes;
+	}
+};
+
+}
+
+#endif
@@ -1,14 +1,29 @@
 // Copyright (C) 2011  Lukas Lalinsky
 // Distributed under the MIT license, see the LICENSE file for details.
 
+#include <algorithm>
 #include "store/output_stream.h"
+#include "util/vint.h"
+#include "segment_info.h"
 #include "segment_data_reader.h"
 
 using namespace Acoustid;
 
-SegmentDataReader::SegmentDataReader(InputStream *input, size_t blockSize)
-	: m_input(input), m_blockSize(blockSize)
+// Padding at the end of the block buffer, so that the decoders can't read past it.
+static const size_t kBufferPadding = std::max(kVInt32ArrayPadding, kStreamVByte32Padding);
+
+SegmentDataReader::SegmentDataReader(InputStream *input, size_t blockSize, int version)
+	: m_input(input), m_fileData(nullptr), m_fileSize(0), m_version(version), m_cache(nullptr), m_cacheSegment(0),
+	  m_length(0), m_valuesOffset(0), m_block(0)
 {
+	setBlockSize(blockSize);
+}
+
+SegmentDataReader::SegmentDataReader(InputFileSharedPtr file, size_t blockSize, int version)
+	: m_file(file), m_fileData(file->data()), m_fileSize(file->size()), m_version(version), m_cache(nullptr), m_cacheSegment(0),
+	  m_length(0), m_valuesOffset(0), m_block(0)
+{
+	setBlockSize(blockSize);
 }
 
 SegmentDataReader::~SegmentDataReader()
@@ -18,11 +33,135 @@ SegmentDataReader::~SegmentDataReader()
 void SegmentDataReader::setBlockSize(size_t blockSize)
 {
 	m_blockSize = blockSize;
+	m_buffer.reset(new uint8_t[blockSize + kBufferPadding]);
+	memset(m_buffer.get(), 0, blockSize + kBufferPadding);
+	m_rawBlock = m_buffer.get();
+	m_deltas.reset(new uint32_t[blockSize]);
 }
 
 BlockDataIterator *SegmentDataReader::readBlock(size_t n, uint32_t key)
 {
-	m_input->seek(m_blockSize * n);
-	size_t length = m_input->readInt16();
-	return new BlockDataIterator(m_input.get(), length, key);
+	std::unique_ptr<uint32_t[]> keys(new uint32_t[m_blockSize]);
+	std::unique_ptr<uint32_t[]> values(new uint32_t[m_blockSize]);
+	size_t length = readBlock(n, key, keys.get(), values.get());
+	return new BlockDataIterator(length, keys.release(), values.release());
+}
+
+size_t SegmentDataReader::readBlock(size_t n, uint32_t key, uint32_t *keys, uint32_t *values)
+{
+	size_t length = readBlockKeys(n, key, keys);
+	readBlockValues(keys, values);
+	return length;
+}
+
+// Read the whole block, including the item count. Blocks of files in
+// memory are decoded in place, except the last one, which doesn't have
+// the padding after it.
+void SegmentDataReader::readRawBlock(size_t n)
+{
+	size_t offset = m_blockSize * n;
+	if (m_fileData && offset + m_blockSize + kBufferPadding <= m_fileSize) {
+		m_rawBlock = m_fileData + offset;
+		return;
+	}
+	m_rawBlock = m_buffer.get();
+	if (m_file) {
+		m_file->read(m_buffer.get(), offset, m_blockSize);
+	}
+	else {
+		m_input->seek(m_blockSize * n);
+		m_input->readBytes(m_buffer.get(), m_blockSize);
+	}
+}
+
+void SegmentDataReader::prefetchBlock(size_t n)
+{
+	if (m_file) {
+		m_file->prefetch(m_blockSize * n, m_blockSize);
+	}
+}
+
+size_t SegmentDataReader::readBlockKeys(size_t n, uint32_t key, uint32_t *keys)
+{
+	m_block = n;
+	if (m_cache) {
+		m_cachedBlock = m_cache->find(m_cacheSegment, n);
+		if (m_cachedBlock) {
+			m_length = m_cachedBlock->length();
+			std::copy(m_cachedBlock->keys(), m_cachedBlock->keys() + m_length, keys);
+			return m_length;
+		}
+	}
+	readRawBlock(n);
+	m_length = (m_rawBlock[0] << 8) | m_rawBlock[1];
+	if (!m_length) {
+		return 0;
+	}
+	if (m_length > m_blockSize - 2) {
+		throw CorruptIndexException("invalid number of items in block");
+	}
+
+	keys[0] = key;
+	if (m_version == SEGMENT_FORMAT_V1) {
+		// The first item has only the value, all others have key and value deltas.
+		size_t deltaCount = 2 * m_length - 1;
+		if (deltaCount > m_blockSize - 2) {
+			throw CorruptIndexException("invalid number of items in block");
+		}
+		if (readVInt32ArrayFromArray(blockData(), m_blockSize - 2, m_deltas.get(), deltaCount) == -1) {
+			throw CorruptIndexException("invalid block data");
+		}
+		const uint32_t *deltas = m_deltas.get();
+		for (size_t i = 1; i < m_length; i++) {
+			key += deltas[2 * i - 1];
+			keys[i] = key;
+		}
+	}
+	else {
+		// Key deltas of all but the first item, followed by value deltas.
+		ssize_t size = readStreamVByte32FromArray(blockData(), m_blockSize - 2, keys + 1, m_length - 1);
+		if (size == -1) {
+			throw CorruptIndexException("invalid block data");
+		}
+		m_valuesOffset = size;
+		for (size_t i = 1; i < m_length; i++) {
+			keys[i] += keys[i - 1];
+		}
+	}
+	return m_length;
+}
+
+void SegmentDataReader::readBlockValues(const uint32_t *keys, uint32_t *values)
+{
+	if (!m_length) {
+		return;
+	}
+	if (m_cachedBlock) {
+		std::copy(m_cachedBlock->values(), m_cachedBlock->values() + m_length, values);
+		return;
+	}
+	if (m_version == SEGMENT_FORMAT_V1) {
+		const uint32_t *deltas = m_deltas.get();
+		values[0] = deltas[0];
+		for (size_t i = 1; i < m_length; i++) {
+			values[i] = deltas[2 * i];
+		}
+	}
+	else {
+		if (readStreamVByte32FromArray(blockData() + m_valuesOffset, m_blockSize - 2 - m_valuesOffset, values, m_length) == -1) {
+			throw CorruptIndexException("invalid block data");
+		}
+	}
+	// Values are delta-encoded only within the same key.
+	for (size_t i = 1; i < m_length; i++) {
+		values[i] += keys[i] == keys[i - 1] ? values[i - 1] : 0;
+	}
+	if (m_cache && !(m_fileRef && m_fileRef->isObsolete())) {
+		m_cache->insert(m_cacheSegment, m_block, CachedBlockSharedPtr(new CachedBlock(m_length, keys, values)));
+		// The segment could have been removed from the cache just before
+		// the insert, after the check above.
+		if (m_fileRef && m_fileRef->isObsolete()) {
+			m_cache->removeBlock(m_cacheSegment, m_block);
+		}
+	}
 }
@@ -6,63 +6,106 @@
 
 #include "common.h"
 #include "store/input_stream.h"
+#include "store/input_file.h"
+#include "block_cache.h"
 
 namespace Acoustid {
 
+class SegmentFileRef;
+
 class BlockDataIterator
 {
 public:
-	BlockDataIterator(InputStream *input, size_t length, uint32_t firstKey)
-		: m_input(input), m_length(length), m_position(0), m_key(firstKey)
+	BlockDataIterator(size_t length, uint32_t *keys, uint32_t *values)
+		: m_length(length), m_position(0), m_keys(keys), m_values(values)
 	{
 	}
 
 	bool next()
 	{
-		if (m_position++ >= m_length) {
+		if (m_position >= m_length) {
 			return false;
 		}
-
-		if (m_position == 1) {
-			// first item, read only the value
-			m_value = m_input->readVInt32();
-		}
-		else {
-			// read both key and value
-			uint32_t keyDelta = m_input->readVInt32(); 
-			if (keyDelta) {
-				m_value = 0;
-			}
-			m_key += keyDelta;
-			m_value += m_input->readVInt32();
-		}
+		m_position++;
 		return true;
 	}
 
-	uint32_t key() { return m_key; }
-	uint32_t value() { return m_value; }
+	uint32_t key() { return m_keys[m_position - 1]; }
+	uint32_t value() { return m_values[m_position - 1]; }
 
 private:
-	InputStream *m_input;
-	size_t m_position;
 	size_t m_length;
-	uint32_t m_key, m_value;
+	size_t m_position;
+	std::unique_ptr<uint32_t[]> m_keys;
+	std::unique_ptr<uint32_t[]> m_values;
 };
 
 class SegmentDataReader
 {
 public:
-	SegmentDataReader(InputStream *input, size_t blockSize);
+	SegmentDataReader(InputStream *input, size_t blockSize, int version = SEGMENT_FORMAT_VERSION);
+	// Read from a file shared with other readers
+	SegmentDataReader(InputFileSharedPtr file, size_t blockSize, int version = SEGMENT_FORMAT_VERSION);
 	virtual ~SegmentDataReader();
 
 	size_t blockSize() { return m_blockSize; }
 	void setBlockSize(size_t blockSize);
 
+	// Segment format the data is read in.
+	int version() const { return m_version; }
+
+	// Look up blocks in the cache before decoding them. Blocks whose values
+	// are decoded are added to the cache, unless the segment files are
+	// already obsolete, as their blocks were removed from the cache.
+	void setBlockCache(BlockCache *cache, uint64_t segment, QSharedPointer<SegmentFileRef> fileRef = QSharedPointer<SegmentFileRef>())
+	{
+		m_cache = cache;
+		m_cacheSegment = segment;
+		m_fileRef = fileRef;
+	}
+
 	BlockDataIterator *readBlock(size_t n, uint32_t key);
 
+	// Decode the whole block into the keys/values arrays, which must have
+	// space for at least blockSize() items. Returns the number of items.
+	size_t readBlock(size_t n, uint32_t key, uint32_t *keys, uint32_t *values);
+
+	// Decode only the keys of the block, the values can be decoded later
+	// by readBlockValues() if needed. Returns the number of items.
+	size_t readBlockKeys(size_t n, uint32_t key, uint32_t *keys);
+
+	// Decode the values of the block last read by readBlockKeys(), whose
+	// keys must be passed in.
+	void readBlockValues(const uint32_t *keys, uint32_t *values);
+
+	// Start loading the block into the CPU cache, if the data is in memory.
+	void prefetchBlock(size_t n);
+
 private:
+	void readRawBlock(size_t n);
+
+	// Data of the block last read, without the item count
+	const uint8_t *blockData() const { return m_rawBlock + 2; }
+
 	std::unique_ptr<InputStream> m_input;
+	InputFileSharedPtr m_file;
+	// Contents of the file, if it's in memory
+	const uint8_t *m_fileData;
+	size_t m_fileSize;
+	std::unique_ptr<uint8_t[]> m_buffer;
+	// The block last read, either in the buffer or in the file data
+	const uint8_t *m_rawBlock;
+	std::unique_ptr<uint32_t[]> m_deltas;
 	size_t m_blockSize;
+	int m_version;
+	BlockCache *m_cache;
+	uint64_t m_cacheSegment;
+	QSharedPointer<SegmentFileRef> m_fileRef;
+	// State of the block last read by readBlockKeys()
+	size_t m_length;
+	size_t m_valuesOffset;
+	size_t m_block;
+	CachedBlockSharedPtr m_cachedBlock;
 };
 
 }
@@ -0,0 +1,170 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <gtest/gtest.h>
+#include "util/test_utils.h"
+#include "store/ram_directory.h"
+#include "store/input_stream.h"
+#include "store/output_stream.h"
+#include "store/memory_input_file.h"
+#include "segment_data_reader.h"
+#include "segment_data_writer.h"
+#include "segment_index_writer.h"
+#include "segment_info.h"
+
+using namespace Acoustid;
+
+enum ReaderInput {
+	StreamInput,
+	SharedFileInput,
+	// Shared file in memory, with enough space after the blocks to decode them in place
+	MemoryFileInput,
+};
+
+static void testReadBlock(int version, BlockCache *cache = nullptr, ReaderInput input = StreamInput)
+{
+	RAMDirectory dir;
+	std::vector<uint32_t> firstKeys;
+
+	{
+		SegmentIndexWriter *indexWriter = new SegmentIndexWriter(dir.createFile("segment_0.fii"));
+		SegmentDataWriter writer(dir.createFile("segment_0.fid"), indexWriter, 16, version);
+		writer.addItem(200, 300);
+		writer.addItem(201, 301);
+		writer.addItem(201, 302);
+		writer.addItem(202, 100000);
+		writer.addItem(202, 100001);
+		writer.addItem(300000, 1);
+		writer.addItem(300001, 2);
+		writer.close();
+		ASSERT_EQ(2, writer.blockCount());
+		for (size_t i = 0; i < writer.blockCount(); i++) {
+			firstKeys.push_back(writer.index()->key(i));
+		}
+	}
+
+	std::unique_ptr<SegmentDataReader> readerPtr;
+	std::vector<uint8_t> fileData;
+	if (input == MemoryFileInput) {
+		InputFileSharedPtr file = dir.openInputFile("segment_0.fid");
+		ASSERT_TRUE(file->data() != nullptr);
+		fileData.assign(file->data(), file->data() + file->size());
+		fileData.resize(fileData.size() + 1024, 0);
+		InputFileSharedPtr memoryFile(new MemoryInputFile(fileData.data(), fileData.size()));
+		readerPtr.reset(new SegmentDataReader(memoryFile, 16, version));
+	}
+	else if (input == SharedFileInput) {
+		readerPtr.reset(new SegmentDataReader(dir.openInputFile("segment_0.fid"), 16, version));
+	}
+	else {
+		readerPtr.reset(new SegmentDataReader(dir.openFile("segment_0.fid"), 16, version));
+	}
+	SegmentDataReader &reader = *readerPtr;
+	if (cache) {
+		reader.setBlockCache(cache, 1);
+	}
+	uint32_t keys[16], values[16];
+	std::vector<uint32_t> allKeys, allValues;
+	for (size_t i = 0; i < firstKeys.size(); i++) {
+		size_t length = reader.readBlock(i, firstKeys[i], keys, values);
+		std::unique_ptr<BlockDataIterator> iter(reader.readBlock(i, firstKeys[i]));
+		for (size_t j = 0; j < length; j++) {
+			ASSERT_TRUE(iter->next());
+			ASSERT_EQ(iter->key(), keys[j]);
+			ASSERT_EQ(iter->value(), values[j]);
+			allKeys.push_back(keys[j]);
+			allValues.push_back(values[j]);
+		}
+		ASSERT_FALSE(iter->next());
+	}
+
+	uint32_t expectedKeys[] = { 200, 201, 201, 202, 202, 300000, 300001 };
+	uint32_t expectedValues[] = { 300, 301, 302, 100000, 100001, 1, 2 };
+	ASSERT_EQ(7, allKeys.size());
+	ASSERT_INTARRAY_EQ(expectedKeys, allKeys, 7);
+	ASSERT_INTARRAY_EQ(expectedValues, allValues, 7);
+
+	size_t length = reader.readBlockKeys(0, 200, keys);
+	ASSERT_INTARRAY_EQ(expectedKeys, keys, length);
+	reader.readBlockValues(keys, values);
+	ASSERT_INTARRAY_EQ(expectedValues, values, length);
+}
+
+TEST(SegmentDataReaderTest, ReadBlock)
+{
+	testReadBlock(SEGMENT_FORMAT_V1);
+}
+
+TEST(SegmentDataReaderTest, ReadBlockV2)
+{
+	testReadBlock(SEGMENT_FORMAT_V2);
+}
+
+TEST(SegmentDataReaderTest, ReadBlockV3)
+{
+	testReadBlock(SEGMENT_FORMAT_V3);
+}
+
+TEST(SegmentDataReaderTest, ReadBlockSharedFile)
+{
+	testReadBlock(SEGMENT_FORMAT_V1, nullptr, SharedFileInput);
+	testReadBlock(SEGMENT_FORMAT_V3, nullptr, SharedFileInput);
+}
+
+TEST(SegmentDataReaderTest, ReadBlockInPlace)
+{
+	testReadBlock(SEGMENT_FORMAT_V1, nullptr, MemoryFileInput);
+	testReadBlock(SEGMENT_FORMAT_V3, nullptr, MemoryFileInput);
+}
+
+TEST(SegmentDataReaderTest, ReadBlockCached)
+{
+	BlockCache cache;
+	testReadBlock(SEGMENT_FORMAT_V3, &cache);
+	// The first read of each block is a miss, the rest come from the cache
+	ASSERT_EQ(2, cache.missCount());
+	ASSERT_EQ(3, cache.hitCount());
+}
+
+TEST(SegmentDataReaderTest, ReadBlockObsoleteSegment)
+{
+	RAMDirectory dir;
+	{
+		SegmentDataWriter writer(dir.createFile("segment_0.fid"), nullptr, 16, SEGMENT_FORMAT_V3);
+		writer.addItem(200, 300);
+		writer.addItem(201, 301);
+		writer.close();
+	}
+
+	BlockCache cache;
+	SegmentFileRefSharedPtr fileRef(new SegmentFileRef(DirectorySharedPtr(), QList<QString>()));
+	SegmentDataReader reader(dir.openInputFile("segment_0.fid"), 16, SEGMENT_FORMAT_V3);
+	reader.setBlockCache(&cache, 1, fileRef);
+	uint32_t keys[16], values[16];
+	ASSERT_EQ(2, reader.readBlock(0, 200, keys, values));
+	ASSERT_NE(0, cache.size());
+
+	// Blocks of obsolete segments are not added back to the cache
+	cache.removeSegment(1);
+	fileRef->markObsolete();
+	ASSERT_EQ(2, reader.readBlock(0, 200, keys, values));
+	ASSERT_EQ(0, cache.size());
+}
+
+TEST(SegmentDataReaderTest, ReadBlockCorrupt)
+{
+	RAMDirectory dir;
+
+	{
+		// 13 deltas don't fit into the 14 bytes of 2-byte varints
+		std::unique_ptr<OutputStream> output(dir.createFile("segment_0.fid"));
+		output->writeInt16(7);
+		for (size_t i = 0; i < 7; i++) {
+			output->writeVInt32(200);
+		}
+	}
+
+	SegmentDataReader reader(dir.openFile("segment_0.fid"), 16, SEGMENT_FORMAT_V1);
+	uint32_t keys[16], values[16];
+	ASSERT_THROW(reader.readBlock(0, 100, keys, values), CorruptIndexException);
+}
@@ -8,11 +8,13 @@
 
 using namespace Acoustid;
 
-SegmentDataWriter::SegmentDataWriter(OutputStream *output, SegmentIndexWriter *indexWriter, size_t blockSize)
-	: m_output(output), m_indexWriter(indexWriter), m_blockSize(blockSize),
-	  m_buffer(0), m_ptr(0), m_itemCount(0), m_lastKey(0), m_lastValue(0),
-	  m_blockCount(0), m_checksum(0)
+SegmentDataWriter::SegmentDataWriter(OutputStream *output, SegmentIndexWriter *indexWriter, size_t blockSize, int version)
+	: m_output(output), m_indexWriter(indexWriter), m_blockSize(blockSize), m_version(version),
+	  m_buffer(0), m_ptr(0), m_itemCount(0), m_lastKey(0), m_lastValue(0), m_blockLastKey(0), m_blockLastValue(0),
+	  m_blockCount(0), m_checksum(0), m_dataSize(0), m_maxFilterKeys(0), m_filterOverflow(false),
+	  m_maxHeavyKeys(0), m_keyFrequency(0), m_minPostingListSize(0)
 {
+	m_sketch.clear();
 }
 
 SegmentDataWriter::~SegmentDataWriter()
@@ -26,9 +28,41 @@ void SegmentDataWriter::setBlockSize(size_t blockSize)
 	m_blockSize = blockSize;
 }
 
+size_t SegmentDataWriter::blockSizeWith(uint32_t keyDelta, uint32_t valueDelta) const
+{
+	size_t size = 2;
+	if (m_version == SEGMENT_FORMAT_V1) {
+		size += m_ptr - m_buffer.get();
+		size += m_itemCount ? checkVInt32Size(keyDelta) : 0;
+		size += checkVInt32Size(valueDelta);
+	}
+	else {
+		size += m_dataSize;
+		size += streamVByte32ControlSize(m_itemCount);
+		size += streamVByte32ControlSize(m_itemCount + 1);
+		size += m_itemCount ? checkStreamVByte32Size(keyDelta) : 0;
+		size += checkStreamVByte32Size(valueDelta);
+	}
+	return size;
+}
+
 void SegmentDataWriter::writeBlock()
 {
 	assert(m_itemCount < (1 << 16));
+	if (m_version != SEGMENT_FORMAT_V1) {
+		// The key deltas of all but the first item, followed by all value deltas
+		uint8_t *ptr = m_buffer.get();
+		ptr += writeStreamVByte32ToArray(ptr, m_keyDeltas.data(), m_keyDeltas.size());
+		ptr += writeStreamVByte32ToArray(ptr, m_valueDeltas.data(), m_valueDeltas.size());
+		assert(ptr - m_buffer.get() <= m_blockSize - 2);
+		m_keyDeltas.clear();
+		m_valueDeltas.clear();
+		m_dataSize = 0;
+	}
+	if (m_version >= SEGMENT_FORMAT_V3) {
+		m_sketchData.push_back(m_sketch);
+		m_sketch.clear();
+	}
 	m_output->writeInt16(m_itemCount);
 	m_output->writeBytes(m_buffer.get(), m_blockSize - 2);
 	m_ptr = m_buffer.get();
@@ -37,29 +71,18 @@ void SegmentDataWriter::writeBlock()
 	memset(m_buffer.get(), 0, m_blockSize);
 }
 
-void SegmentDataWriter::addItem(uint32_t key, uint32_t value)
+void SegmentDataWriter::writeItem(uint32_t key, uint32_t value)
 {
-	assert(key >= m_lastKey);
-	assert(key == m_lastKey ? value >= m_lastValue : 1);
-
-	//qDebug() << "Adding" << key << "to checksum =" << m_checksum;
-	m_checksum ^= key;
-	m_checksum ^= value;
-
 	if (!m_buffer) {
 		m_buffer.reset(new uint8_t[m_blockSize]);
 		memset(m_buffer.get(), 0, m_blockSize);
 		m_ptr = m_buffer.get();
 	}
 
-	uint32_t keyDelta = m_itemCount ? key - m_lastKey : UINT32_MAX;
-	uint32_t valueDelta = keyDelta ? value : value - m_lastValue;
-
-	size_t currentSize = m_ptr - m_buffer.get();
-	currentSize += 2;
-	currentSize += m_itemCount ? checkVInt32Size(keyDelta) : 0;
-	currentSize += checkVInt32Size(valueDelta);
+	uint32_t keyDelta = m_itemCount ? key - m_blockLastKey : UINT32_MAX;
+	uint32_t valueDelta = keyDelta ? value : value - m_blockLastValue;
 
+	size_t currentSize = blockSizeWith(keyDelta, valueDelta);
 	if (currentSize > m_blockSize) {
 		writeBlock();
 		keyDelta = key;
@@ -67,7 +90,13 @@ void SegmentDataWriter::addItem(uint32_t key, uint32_t value)
 	}
 
 	if (m_itemCount) {
-		m_ptr += writeVInt32ToArray(m_ptr, keyDelta);
+		if (m_version == SEGMENT_FORMAT_V1) {
+			m_ptr += writeVInt32ToArray(m_ptr, keyDelta);
+		}
+		else {
+			m_keyDeltas.push_back(keyDelta);
+			m_dataSize += checkStreamVByte32Size(keyDelta);
+		}
 	}
 	else {
 		m_indexData.push_back(key);
@@ -75,10 +104,17 @@ void SegmentDataWriter::addItem(uint32_t key, uint32_t value)
 			m_indexWriter->addItem(key);
 		}
 	}
-	m_ptr += writeVInt32ToArray(m_ptr, valueDelta);
+	if (m_version == SEGMENT_FORMAT_V1) {
+		m_ptr += writeVInt32ToArray(m_ptr, valueDelta);
+	}
+	else {
+		m_valueDeltas.push_back(valueDelta);
+		m_dataSize += checkStreamVByte32Size(valueDelta);
+	}
+	m_sketch.add(key);
 
-	m_lastKey = key;
-	m_lastValue = value;
+	m_blockLastKey = key;
+	m_blockLastValue = value;
 	m_itemCount++;
 
 	if (currentSize == m_blockSize) {
@@ -86,15 +122,108 @@ void SegmentDataWriter::addItem(uint32_t key, uint32_t value)
 	}
 }
 
+// Write the values of the last key either into a separate posting list,
+// or into the blocks.
+void SegmentDataWriter::writePendingItems()
+{
+	if (m_pendingValues.empty()) {
+		return;
+	}
+	if (m_pendingValues.size() >= m_minPostingListSize) {
+		if (!m_postings) {
+			m_postings = SegmentPostingsSharedPtr(new SegmentPostings());
+		}
+		m_postings->add(m_lastKey, m_pendingValues.data(), m_pendingValues.size());
+	}
+	else {
+		for (size_t i = 0; i < m_pendingValues.size(); i++) {
+			writeItem(m_lastKey, m_pendingValues[i]);
+		}
+	}
+	m_pendingValues.clear();
+}
+
+void SegmentDataWriter::addItem(uint32_t key, uint32_t value)
+{
+	assert(key >= m_lastKey);
+	assert(key == m_lastKey ? value >= m_lastValue : 1);
+
+	//qDebug() << "Adding" << key << "to checksum =" << m_checksum;
+	m_checksum ^= key;
+	m_checksum ^= value;
+
+	if (m_minPostingListSize) {
+		if (key != m_lastKey) {
+			writePendingItems();
+		}
+		m_pendingValues.push_back(value);
+	}
+	else {
+		writeItem(key, value);
+	}
+
+	if (m_maxFilterKeys && !m_filterOverflow && (m_filterKeys.empty() || m_filterKeys.back() != key)) {
+		if (m_filterKeys.size() < m_maxFilterKeys) {
+			m_filterKeys.push_back(key);
+		}
+		else {
+			m_filterOverflow = true;
+			std::vector<uint32_t>().swap(m_filterKeys);
+		}
+	}
+
+	if (m_maxHeavyKeys) {
+		if (!m_heavyKeys) {
+			m_heavyKeys = SegmentHeavyKeysSharedPtr(new SegmentHeavyKeys(m_maxHeavyKeys));
+		}
+		else if (key != m_lastKey) {
+			m_heavyKeys->add(m_lastKey, m_keyFrequency);
+			m_keyFrequency = 0;
+		}
+		m_keyFrequency++;
+	}
+
+	m_lastKey = key;
+	m_lastValue = value;
+}
+
 void SegmentDataWriter::close()
 {
+	if (m_index) {
+		// Already closed
+		return;
+	}
+	writePendingItems();
 	if (m_itemCount) {
 		writeBlock();
 	}
-	m_index = SegmentIndexSharedPtr(new SegmentIndex(m_blockCount));
+	bool hasSketches = m_version >= SEGMENT_FORMAT_V3;
+	m_index = SegmentIndexSharedPtr(new SegmentIndex(m_blockCount, hasSketches));
 	std::copy(m_indexData.begin(), m_indexData.end(), m_index->keys());
-	m_indexData.clear();
+	std::vector<uint32_t>().swap(m_indexData);
+	m_index->build();
+	if (hasSketches) {
+		// From now on, the sketches are kept only in the in-memory index.
+		std::copy(m_sketchData.begin(), m_sketchData.end(), m_index->sketches());
+		std::vector<BlockSketch>().swap(m_sketchData);
+	}
+	if (!m_filterKeys.empty()) {
+		m_filter = SegmentFilterSharedPtr(new SegmentFilter(SegmentFilter::bucketCountFor(m_filterKeys.size())));
+		for (size_t i = 0; i < m_filterKeys.size(); i++) {
+			m_filter->add(m_filterKeys[i]);
+		}
+		std::vector<uint32_t>().swap(m_filterKeys);
+	}
+	if (m_heavyKeys) {
+		m_heavyKeys->add(m_lastKey, m_keyFrequency);
+		m_heavyKeys->finish();
+	}
 	m_output->flush();
-	m_indexWriter->close();
+	if (m_indexWriter) {
+		if (hasSketches) {
+			m_indexWriter->addSketches(m_index->sketches(), m_blockCount);
+		}
+		m_indexWriter->close();
+	}
 }
 
@@ -6,6 +6,9 @@
 
 #include "common.h"
 #include "segment_index.h"
+#include "segment_filter.h"
+#include "segment_heavy_keys.h"
+#include "segment_postings.h"
 
 namespace Acoustid {
 
@@ -17,7 +20,7 @@ typedef QPair<uint32_t, uint32_t> Int32Pair;
 class SegmentDataWriter
 {
 public:
-	SegmentDataWriter(OutputStream *output, SegmentIndexWriter *indexWriter, size_t blockSize);
+	SegmentDataWriter(OutputStream *output, SegmentIndexWriter *indexWriter, size_t blockSize, int version = SEGMENT_FORMAT_VERSION);
 	virtual ~SegmentDataWriter();
 
 	// Number of blocks written into the file.
@@ -33,24 +36,76 @@ public:
 	size_t blockSize() { return m_blockSize; }
 	void setBlockSize(size_t blockSize);
 
+	// Segment format the data is written in.
+	int version() const { return m_version; }
+
+	// Build a key filter if the segment has at most this many distinct keys.
+	size_t maxFilterKeys() const { return m_maxFilterKeys; }
+	void setMaxFilterKeys(size_t maxFilterKeys) { m_maxFilterKeys = maxFilterKeys; }
+
+	// Key filter, available after close(), or NULL if there are too many keys.
+	SegmentFilterSharedPtr filter() const { return m_filter; }
+
+	// Number of most frequent keys whose frequency is recorded.
+	size_t maxHeavyKeys() const { return m_maxHeavyKeys; }
+	void setMaxHeavyKeys(size_t maxHeavyKeys) { m_maxHeavyKeys = maxHeavyKeys; }
+
+	// Table of the most frequent keys, available after close(), or NULL if
+	// it's not enabled.
+	SegmentHeavyKeysSharedPtr heavyKeys() const { return m_heavyKeys; }
+
+	// Keys with at least this many items get a separate posting list
+	// instead of being written into the blocks, zero disables it.
+	size_t minPostingListSize() const { return m_minPostingListSize; }
+	void setMinPostingListSize(size_t minPostingListSize) { m_minPostingListSize = minPostingListSize; }
+
+	// Separate posting lists, available after close(), or NULL if no key
+	// has enough items.
+	SegmentPostingsSharedPtr postings() const { return m_postings; }
+
 	void addItem(uint32_t key, uint32_t value);
 	void close();
 
 private:
+	// Size of the current block if it had one more item
+	size_t blockSizeWith(uint32_t keyDelta, uint32_t valueDelta) const;
 	void writeBlock();
+	void writeItem(uint32_t key, uint32_t value);
+	void writePendingItems();
 
 	std::unique_ptr<OutputStream> m_output;
 	std::unique_ptr<SegmentIndexWriter> m_indexWriter;
 	SegmentIndexSharedPtr m_index;
 	std::vector<uint32_t> m_indexData;
 	size_t m_blockSize;
+	int m_version;
 	uint32_t m_lastKey;
 	uint32_t m_lastValue;
+	// Last item written into a block
+	uint32_t m_blockLastKey;
+	uint32_t m_blockLastValue;
 	uint32_t m_checksum;
 	size_t m_itemCount;
 	size_t m_blockCount;
 	uint8_t *m_ptr;
 	std::unique_ptr<uint8_t[]> m_buffer;
+	// Items of the current block for SEGMENT_FORMAT_V2 and newer
+	std::vector<uint32_t> m_keyDeltas;
+	std::vector<uint32_t> m_valueDeltas;
+	size_t m_dataSize;
+	BlockSketch m_sketch;
+	std::vector<BlockSketch> m_sketchData;
+	size_t m_maxFilterKeys;
+	std::vector<uint32_t> m_filterKeys;
+	bool m_filterOverflow;
+	SegmentFilterSharedPtr m_filter;
+	size_t m_maxHeavyKeys;
+	uint32_t m_keyFrequency;
+	SegmentHeavyKeysSharedPtr m_heavyKeys;
+	size_t m_minPostingListSize;
+	// Values of the last key, until it's known where they go
+	std::vector<uint32_t> m_pendingValues;
+	SegmentPostingsSharedPtr m_postings;
 };
 
 }
@@ -27,7 +27,7 @@ TEST_F(SegmentDataWriterTest, Write)
 {
 	SegmentIndexWriter *indexWriter = new SegmentIndexWriter(indexStream);
 
-	SegmentDataWriter writer(stream, indexWriter, 8);
+	SegmentDataWriter writer(stream, indexWriter, 8, SEGMENT_FORMAT_V1);
 	writer.addItem(200, 300);
 	writer.addItem(201, 301);
 	writer.addItem(201, 302);
@@ -50,3 +50,36 @@ TEST_F(SegmentDataWriterTest, Write)
 	ASSERT_EQ(303, input->readVInt32());
 }
 
+
+TEST_F(SegmentDataWriterTest, WriteV2)
+{
+	SegmentIndexWriter *indexWriter = new SegmentIndexWriter(indexStream);
+
+	SegmentDataWriter writer(stream, indexWriter, 12, SEGMENT_FORMAT_V2);
+	writer.addItem(200, 300);
+	writer.addItem(201, 301);
+	writer.addItem(201, 302);
+	writer.addItem(202, 303);
+	writer.close();
+	ASSERT_EQ(2, writer.blockCount());
+	ASSERT_EQ(2, writer.checksum());
+
+	std::unique_ptr<FSInputStream> input(FSInputStream::open(stream->fileName()));
+
+	ASSERT_EQ(3, input->readInt16());
+	ASSERT_EQ(0x00, input->readByte()); // key delta sizes
+	ASSERT_EQ(1, input->readByte());
+	ASSERT_EQ(0x00, input->readByte());
+	ASSERT_EQ(0x05, input->readByte()); // value delta sizes
+	ASSERT_EQ(300 & 0xFF, input->readByte());
+	ASSERT_EQ(300 >> 8, input->readByte());
+	ASSERT_EQ(301 & 0xFF, input->readByte());
+	ASSERT_EQ(301 >> 8, input->readByte());
+	ASSERT_EQ(1, input->readByte());
+
+	input->seek(12);
+	ASSERT_EQ(1, input->readInt16());
+	ASSERT_EQ(0x01, input->readByte());
+	ASSERT_EQ(303 & 0xFF, input->readByte());
+	ASSERT_EQ(303 >> 8, input->readByte());
+}
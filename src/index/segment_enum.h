@@ -7,46 +7,114 @@
 #include "common.h"
 #include "segment_index.h"
 #include "segment_data_reader.h"
+#include "segment_postings.h"
 
 namespace Acoustid {
 
+// Iterates over all items of a segment. Items of the keys with separate
+// posting lists are merged with the block items by key, as a key is never
+// in both.
 class SegmentEnum
 {
 public:
-	SegmentEnum(SegmentIndexSharedPtr index, SegmentDataReader *dataReader)
-		: m_index(index), m_dataReader(dataReader), m_block(0),
-		  m_currentBlock(nullptr)
+	SegmentEnum(SegmentIndexSharedPtr index, SegmentDataReader *dataReader, SegmentPostingsSharedPtr postings = SegmentPostingsSharedPtr())
+		: m_index(index), m_dataReader(dataReader), m_postings(postings), m_block(0),
+		  m_length(0), m_position(0), m_postingKey(0), m_postingPosition(0),
+		  m_hasBlockItem(false), m_hasPostingItem(false), m_fromPostings(false), m_started(false),
+		  m_keys(new uint32_t[dataReader->blockSize()]),
+		  m_values(new uint32_t[dataReader->blockSize()])
 	{}
 
 	bool next()
 	{
-		if (!m_currentBlock.get() || !m_currentBlock->next()) {
+		if (!m_started) {
+			m_hasBlockItem = nextBlockItem();
+			m_hasPostingItem = nextPostingItem();
+			m_started = true;
+		}
+		else if (m_fromPostings) {
+			m_hasPostingItem = nextPostingItem();
+		}
+		else {
+			m_hasBlockItem = nextBlockItem();
+		}
+		if (!m_hasBlockItem && !m_hasPostingItem) {
+			return false;
+		}
+		m_fromPostings = !m_hasBlockItem || (m_hasPostingItem && postingKey() < blockKey());
+		return true;
+	}
+
+	uint32_t key()
+	{
+		return m_fromPostings ? postingKey() : blockKey();
+	}
+
+	uint32_t value()
+	{
+		return m_fromPostings ? m_postingValues[m_postingPosition - 1] : m_values[m_position - 1];
+	}
+
+private:
+	bool nextBlockItem()
+	{
+		while (m_position >= m_length) {
 			if (m_block >= m_index->blockCount()) {
 				return false;
 			}
 			uint32_t firstKey = m_index->key(m_block);
-			m_currentBlock.reset(m_dataReader->readBlock(m_block, firstKey));
-			m_currentBlock->next();
+			m_length = m_dataReader->readBlock(m_block, firstKey, m_keys.get(), m_values.get());
+			m_position = 0;
 			m_block++;
 		}
+		m_position++;
 		return true;
 	}
 
-	uint32_t key()
+	bool nextPostingItem()
+	{
+		while (m_postingPosition >= m_postingValues.size()) {
+			if (!m_postings || m_postingKey >= m_postings->size()) {
+				return false;
+			}
+			m_postingValues.clear();
+			m_postings->read(m_postingKey, [this](const uint32_t *values, size_t count) {
+				m_postingValues.insert(m_postingValues.end(), values, values + count);
+			});
+			m_postingPosition = 0;
+			m_postingKey++;
+		}
+		m_postingPosition++;
+		return true;
+	}
+
+	uint32_t blockKey()
 	{
-		return m_currentBlock->key();
+		return m_keys[m_position - 1];
 	}
 
-	uint32_t value()
+	uint32_t postingKey()
 	{
-		return m_currentBlock->value();
+		return m_postings->key(m_postingKey - 1);
 	}
 
-private:
-	size_t m_block;
 	SegmentIndexSharedPtr m_index;
 	std::unique_ptr<SegmentDataReader> m_dataReader;
-	std::unique_ptr<BlockDataIterator> m_currentBlock;
+	SegmentPostingsSharedPtr m_postings;
+	size_t m_block;
+	size_t m_length;
+	size_t m_position;
+	// Next posting list to read, and the values of the current one
+	size_t m_postingKey;
+	size_t m_postingPosition;
+	std::vector<uint32_t> m_postingValues;
+	bool m_hasBlockItem;
+	bool m_hasPostingItem;
+	// Whether the current item is from a posting list
+	bool m_fromPostings;
+	bool m_started;
+	std::unique_ptr<uint32_t[]> m_keys;
+	std::unique_ptr<uint32_t[]> m_values;
 };
 
 }
@@ -0,0 +1,79 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include "store/input_stream.h"
+#include "store/output_stream.h"
+#include "util/crc.h"
+#include "segment_filter.h"
+
+using namespace Acoustid;
+
+SegmentFilter::SegmentFilter(size_t bucketCount)
+	: m_bucketCount(bucketCount), m_buckets(new uint32_t[bucketCount * kBucketWords])
+{
+	assert(bucketCount && !(bucketCount & (bucketCount - 1)));
+	memset(m_buckets.get(), 0, bucketCount * kBucketWords * sizeof(uint32_t));
+}
+
+SegmentFilter::~SegmentFilter()
+{
+}
+
+size_t SegmentFilter::bucketCountFor(size_t keyCount)
+{
+	size_t bucketBits = kBucketWords * 32;
+	size_t minBucketCount = (keyCount * kBitsPerKey + bucketBits - 1) / bucketBits;
+	size_t bucketCount = 1;
+	while (bucketCount < minBucketCount) {
+		bucketCount *= 2;
+	}
+	return bucketCount;
+}
+
+void SegmentFilter::add(uint32_t key)
+{
+	uint64_t hash = key * UINT64_C(0x9E3779B97F4A7C15);
+	uint32_t *bucket = m_buckets.get() + this->bucket(hash) * kBucketWords;
+	for (int i = 0; i < kBucketWords; i++) {
+		bucket[i] |= mask(hash, i);
+	}
+}
+
+// CRC of the values in the byte order they are stored in
+uint32_t SegmentFilter::updateChecksum(uint32_t checksum, uint32_t value)
+{
+	uint8_t bytes[4] = { uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) };
+	return crc_update(checksum, bytes, 4);
+}
+
+void SegmentFilter::save(OutputStream *output) const
+{
+	output->writeVInt32(m_bucketCount);
+	uint32_t checksum = updateChecksum(0, m_bucketCount);
+	const uint32_t *words = m_buckets.get();
+	for (size_t i = 0; i < m_bucketCount * kBucketWords; i++) {
+		output->writeInt32(words[i]);
+		checksum = updateChecksum(checksum, words[i]);
+	}
+	output->writeInt32(checksum);
+	output->flush();
+}
+
+SegmentFilterSharedPtr SegmentFilter::load(InputStream *input)
+{
+	size_t bucketCount = input->readVInt32();
+	if (!bucketCount || (bucketCount & (bucketCount - 1)) || bucketCount > bucketCountFor(MAX_SEGMENT_FILTER_KEYS)) {
+		throw CorruptIndexException(QString("invalid number of filter buckets %1").arg(bucketCount));
+	}
+	uint32_t checksum = updateChecksum(0, bucketCount);
+	SegmentFilterSharedPtr filter(new SegmentFilter(bucketCount));
+	uint32_t *words = filter->m_buckets.get();
+	for (size_t i = 0; i < bucketCount * kBucketWords; i++) {
+		words[i] = input->readInt32();
+		checksum = updateChecksum(checksum, words[i]);
+	}
+	if (input->readInt32() != checksum) {
+		throw CorruptIndexException("filter checksum mismatch");
+	}
+	return filter;
+}
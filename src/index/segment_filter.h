@@ -0,0 +1,79 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_INDEX_SEGMENT_FILTER_H_
+#define ACOUSTID_INDEX_SEGMENT_FILTER_H_
+
+#include <QSharedPointer>
+#include "common.h"
+
+namespace Acoustid {
+
+class InputStream;
+class OutputStream;
+
+// Split block Bloom filter over all keys of a segment. A key selects one
+// 256-bit bucket and sets one bit in each of its eight words, so checking
+// a key touches only one cache line. With ~10 bits per key, about 1% of
+// absent keys are reported as present. The number of buckets is a power
+// of two.
+class SegmentFilter
+{
+public:
+	static const int kBucketWords = 8;
+	static const int kBitsPerKey = 10;
+
+	SegmentFilter(size_t bucketCount);
+	virtual ~SegmentFilter();
+
+	// Number of buckets needed for the given number of distinct keys,
+	// rounded up to a power of two.
+	static size_t bucketCountFor(size_t keyCount);
+
+	size_t bucketCount() const { return m_bucketCount; }
+
+	void add(uint32_t key);
+
+	// Return false if the key is definitely not in the segment.
+	bool mayContain(uint32_t key) const
+	{
+		uint64_t hash = key * UINT64_C(0x9E3779B97F4A7C15);
+		const uint32_t *bucket = m_buckets.get() + this->bucket(hash) * kBucketWords;
+		for (int i = 0; i < kBucketWords; i++) {
+			if (!(bucket[i] & mask(hash, i))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void save(OutputStream *output) const;
+	static QSharedPointer<SegmentFilter> load(InputStream *input);
+
+private:
+	size_t bucket(uint64_t hash) const
+	{
+		return (hash >> 32) & (m_bucketCount - 1);
+	}
+
+	static uint32_t mask(uint64_t hash, int word)
+	{
+		static const uint32_t salt[kBucketWords] = {
+			0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+			0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+		};
+		return UINT32_C(1) << ((uint32_t(hash) * salt[word]) >> 27);
+	}
+
+	static uint32_t updateChecksum(uint32_t checksum, uint32_t value);
+
+	size_t m_bucketCount;
+	std::unique_ptr<uint32_t[]> m_buckets;
+};
+
+typedef QWeakPointer<SegmentFilter> SegmentFilterWeakPtr;
+typedef QSharedPointer<SegmentFilter> SegmentFilterSharedPtr;
+
+}
+
+#endif
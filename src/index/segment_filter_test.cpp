@@ -0,0 +1,98 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <gtest/gtest.h>
+#include "util/test_utils.h"
+#include "store/ram_directory.h"
+#include "store/input_stream.h"
+#include "store/output_stream.h"
+#include "segment_filter.h"
+
+using namespace Acoustid;
+
+TEST(SegmentFilterTest, BucketCount)
+{
+	ASSERT_EQ(1, SegmentFilter::bucketCountFor(0));
+	ASSERT_EQ(1, SegmentFilter::bucketCountFor(25));
+	ASSERT_EQ(2, SegmentFilter::bucketCountFor(26));
+	ASSERT_EQ(2, SegmentFilter::bucketCountFor(51));
+	ASSERT_EQ(4, SegmentFilter::bucketCountFor(52));
+	ASSERT_EQ(64, SegmentFilter::bucketCountFor(1024));
+}
+
+TEST(SegmentFilterTest, MayContain)
+{
+	size_t keyCount = 10000;
+	SegmentFilter filter(SegmentFilter::bucketCountFor(keyCount));
+	for (uint32_t i = 0; i < keyCount; i++) {
+		filter.add(i * 7);
+	}
+	for (uint32_t i = 0; i < keyCount; i++) {
+		ASSERT_TRUE(filter.mayContain(i * 7));
+	}
+	size_t falsePositives = 0;
+	for (uint32_t i = 0; i < keyCount; i++) {
+		if (filter.mayContain(i * 7 + 3)) {
+			falsePositives++;
+		}
+	}
+	ASSERT_LT(falsePositives, keyCount / 20);
+}
+
+TEST(SegmentFilterTest, SaveAndLoad)
+{
+	RAMDirectory dir;
+	SegmentFilter filter(SegmentFilter::bucketCountFor(100));
+	for (uint32_t i = 0; i < 100; i++) {
+		filter.add(i * 13);
+	}
+	{
+		std::unique_ptr<OutputStream> output(dir.createFile("segment_0.fif"));
+		filter.save(output.get());
+	}
+	std::unique_ptr<InputStream> input(dir.openFile("segment_0.fif"));
+	SegmentFilterSharedPtr filter2 = SegmentFilter::load(input.get());
+	ASSERT_EQ(filter.bucketCount(), filter2->bucketCount());
+	for (uint32_t i = 0; i < 1300; i++) {
+		ASSERT_EQ(filter.mayContain(i), filter2->mayContain(i));
+	}
+}
+
+TEST(SegmentFilterTest, LoadCorrupt)
+{
+	RAMDirectory dir;
+	SegmentFilter filter(SegmentFilter::bucketCountFor(100));
+	filter.add(1);
+	{
+		std::unique_ptr<OutputStream> output(dir.createFile("segment_0.fif"));
+		filter.save(output.get());
+	}
+	{
+		// The bucket count must be a power of two
+		std::unique_ptr<OutputStream> output(dir.createFile("segment_1.fif"));
+		output->writeVInt32(3);
+		for (size_t i = 0; i < 3 * SegmentFilter::kBucketWords + 1; i++) {
+			output->writeInt32(0);
+		}
+	}
+	{
+		// Truncated
+		std::unique_ptr<OutputStream> output(dir.createFile("segment_2.fif"));
+		output->writeVInt32(4);
+		output->writeInt32(0);
+	}
+	{
+		// Wrong checksum
+		std::unique_ptr<OutputStream> output(dir.createFile("segment_3.fif"));
+		output->writeVInt32(1);
+		for (size_t i = 0; i < SegmentFilter::kBucketWords + 1; i++) {
+			output->writeInt32(1);
+		}
+	}
+	std::unique_ptr<InputStream> input(dir.openFile("segment_0.fif"));
+	ASSERT_TRUE(SegmentFilter::load(input.get())->mayContain(1));
+	for (int i = 1; i <= 3; i++) {
+		std::unique_ptr<InputStream> input(dir.openFile(QString("segment_%1.fif").arg(i)));
+		ASSERT_THROW(SegmentFilter::load(input.get()), IOException) << "file " << i;
+	}
+}
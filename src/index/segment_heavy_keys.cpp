@@ -0,0 +1,88 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <algorithm>
+#include "store/input_stream.h"
+#include "store/output_stream.h"
+#include "segment_heavy_keys.h"
+
+using namespace Acoustid;
+
+SegmentHeavyKeys::SegmentHeavyKeys(size_t maxKeys)
+	: m_maxKeys(maxKeys), m_maxOtherFrequency(0)
+{
+}
+
+SegmentHeavyKeys::~SegmentHeavyKeys()
+{
+}
+
+void SegmentHeavyKeys::add(uint32_t key, uint32_t frequency)
+{
+	Entry entry = { key, frequency };
+	if (m_entries.size() < m_maxKeys) {
+		m_entries.push_back(entry);
+		std::push_heap(m_entries.begin(), m_entries.end(), lessFrequent);
+		return;
+	}
+	if (m_entries.empty() || frequency <= m_entries.front().frequency) {
+		m_maxOtherFrequency = std::max(m_maxOtherFrequency, frequency);
+		return;
+	}
+	m_maxOtherFrequency = std::max(m_maxOtherFrequency, m_entries.front().frequency);
+	std::pop_heap(m_entries.begin(), m_entries.end(), lessFrequent);
+	m_entries.back() = entry;
+	std::push_heap(m_entries.begin(), m_entries.end(), lessFrequent);
+}
+
+void SegmentHeavyKeys::finish()
+{
+	std::sort(m_entries.begin(), m_entries.end(), [](const Entry &a, const Entry &b) {
+		return a.key < b.key;
+	});
+}
+
+uint32_t SegmentHeavyKeys::frequency(uint32_t key) const
+{
+	std::vector<Entry>::const_iterator it = std::lower_bound(m_entries.begin(), m_entries.end(), key, [](const Entry &entry, uint32_t key) {
+		return entry.key < key;
+	});
+	if (it == m_entries.end() || it->key != key) {
+		return 0;
+	}
+	return it->frequency;
+}
+
+void SegmentHeavyKeys::save(OutputStream *output) const
+{
+	output->writeVInt32(m_maxKeys);
+	output->writeVInt32(m_maxOtherFrequency);
+	output->writeVInt32(m_entries.size());
+	uint32_t lastKey = 0;
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		output->writeVInt32(m_entries[i].key - lastKey);
+		output->writeVInt32(m_entries[i].frequency);
+		lastKey = m_entries[i].key;
+	}
+	output->flush();
+}
+
+SegmentHeavyKeysSharedPtr SegmentHeavyKeys::load(InputStream *input)
+{
+	size_t maxKeys = input->readVInt32();
+	SegmentHeavyKeysSharedPtr heavyKeys(new SegmentHeavyKeys(maxKeys));
+	heavyKeys->m_maxOtherFrequency = input->readVInt32();
+	size_t size = input->readVInt32();
+	if (size > maxKeys) {
+		throw CorruptIndexException("too many heavy keys");
+	}
+	heavyKeys->m_entries.resize(size);
+	uint32_t lastKey = 0;
+	for (size_t i = 0; i < size; i++) {
+		Entry &entry = heavyKeys->m_entries[i];
+		entry.key = lastKey + input->readVInt32();
+		entry.frequency = input->readVInt32();
+		lastKey = entry.key;
+	}
+	return heavyKeys;
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_INDEX_SEGMENT_HEAVY_KEYS_H_
+#define ACOUSTID_INDEX_SEGMENT_HEAVY_KEYS_H_
+
+#include <vector>
+#include <QSharedPointer>
+#include "common.h"
+
+namespace Acoustid {
+
+class InputStream;
+class OutputStream;
+
+// Document frequencies of the most frequent keys in a segment. Keys are
+// added in any order with their exact frequency, only the top maxKeys()
+// are kept. Keys that are not in the table occur at most
+// maxOtherFrequency() times in the segment.
+class SegmentHeavyKeys
+{
+public:
+	SegmentHeavyKeys(size_t maxKeys);
+	virtual ~SegmentHeavyKeys();
+
+	size_t maxKeys() const { return m_maxKeys; }
+	size_t size() const { return m_entries.size(); }
+
+	uint32_t maxOtherFrequency() const { return m_maxOtherFrequency; }
+
+	void add(uint32_t key, uint32_t frequency);
+
+	// Sort the table by key, must be called after adding all keys.
+	void finish();
+
+	// Frequency of the key, or zero if it's not in the table
+	uint32_t frequency(uint32_t key) const;
+
+	void save(OutputStream *output) const;
+	static QSharedPointer<SegmentHeavyKeys> load(InputStream *input);
+
+private:
+	struct Entry
+	{
+		uint32_t key;
+		uint32_t frequency;
+	};
+
+	// Min-heap on frequency while adding, then sorted by key
+	static bool lessFrequent(const Entry &a, const Entry &b) { return a.frequency > b.frequency; }
+
+	size_t m_maxKeys;
+	uint32_t m_maxOtherFrequency;
+	std::vector<Entry> m_entries;
+};
+
+typedef QWeakPointer<SegmentHeavyKeys> SegmentHeavyKeysWeakPtr;
+typedef QSharedPointer<SegmentHeavyKeys> SegmentHeavyKeysSharedPtr;
+
+}
+
+#endif
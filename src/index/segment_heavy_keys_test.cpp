@@ -0,0 +1,66 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <gtest/gtest.h>
+#include "util/test_utils.h"
+#include "store/ram_directory.h"
+#include "store/input_stream.h"
+#include "store/output_stream.h"
+#include "segment_heavy_keys.h"
+
+using namespace Acoustid;
+
+TEST(SegmentHeavyKeysTest, KeepMostFrequent)
+{
+	SegmentHeavyKeys heavyKeys(3);
+	heavyKeys.add(10, 5);
+	heavyKeys.add(20, 1);
+	heavyKeys.add(30, 7);
+	heavyKeys.add(40, 2);
+	heavyKeys.add(50, 9);
+	heavyKeys.add(60, 2);
+	heavyKeys.finish();
+	ASSERT_EQ(3, heavyKeys.size());
+	ASSERT_EQ(5, heavyKeys.frequency(10));
+	ASSERT_EQ(0, heavyKeys.frequency(20));
+	ASSERT_EQ(7, heavyKeys.frequency(30));
+	ASSERT_EQ(0, heavyKeys.frequency(40));
+	ASSERT_EQ(9, heavyKeys.frequency(50));
+	ASSERT_EQ(0, heavyKeys.frequency(60));
+	ASSERT_EQ(2, heavyKeys.maxOtherFrequency());
+}
+
+TEST(SegmentHeavyKeysTest, NotFull)
+{
+	SegmentHeavyKeys heavyKeys(10);
+	heavyKeys.add(10, 5);
+	heavyKeys.add(5, 1);
+	heavyKeys.finish();
+	ASSERT_EQ(2, heavyKeys.size());
+	ASSERT_EQ(1, heavyKeys.frequency(5));
+	ASSERT_EQ(5, heavyKeys.frequency(10));
+	ASSERT_EQ(0, heavyKeys.maxOtherFrequency());
+}
+
+TEST(SegmentHeavyKeysTest, SaveAndLoad)
+{
+	RAMDirectory dir;
+	SegmentHeavyKeys heavyKeys(50);
+	for (uint32_t i = 0; i < 100; i++) {
+		heavyKeys.add(i * 13, i);
+	}
+	heavyKeys.finish();
+	{
+		std::unique_ptr<OutputStream> output(dir.createFile("segment_0.fih"));
+		heavyKeys.save(output.get());
+	}
+	std::unique_ptr<InputStream> input(dir.openFile("segment_0.fih"));
+	SegmentHeavyKeysSharedPtr heavyKeys2 = SegmentHeavyKeys::load(input.get());
+	ASSERT_EQ(50, heavyKeys2->maxKeys());
+	ASSERT_EQ(50, heavyKeys2->size());
+	ASSERT_EQ(49, heavyKeys2->maxOtherFrequency());
+	for (uint32_t i = 0; i < 1300; i++) {
+		ASSERT_EQ(heavyKeys.frequency(i), heavyKeys2->frequency(i));
+	}
+	ASSERT_EQ(99, heavyKeys2->frequency(99 * 13));
+}
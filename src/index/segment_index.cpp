@@ -8,9 +8,11 @@
 
 using namespace Acoustid;
 
-SegmentIndex::SegmentIndex(size_t blockCount)
+SegmentIndex::SegmentIndex(size_t blockCount, bool hasSketches)
 	: m_blockCount(blockCount),
-	  m_keys(new uint32_t[blockCount])
+	  m_keys(new uint32_t[blockCount]),
+	  m_sketches(hasSketches ? new BlockSketch[blockCount] : nullptr),
+	  m_tree(nullptr), m_treeDepth(0), m_radixShift(32), m_lookupMode(BinaryLookup)
 {
 }
 
@@ -18,9 +20,204 @@ SegmentIndex::~SegmentIndex()
 {
 }
 
+// Position of the node in the sorted key array
+size_t SegmentIndex::treeRank(size_t node) const
+{
+	int level = 63 - __builtin_clzll(node);
+	return ((2 * (node - (size_t(1) << level)) + 1) << (m_treeDepth - 1 - level)) - 1;
+}
+
+// With uniformly distributed keys, radix table ranges have one or two
+// blocks. Above this, the tree needs fewer cache misses.
+static const size_t kMaxRadixRange = 64;
+
+void SegmentIndex::build()
+{
+	if (buildRadixTable() <= kMaxRadixRange) {
+		m_lookupMode = RadixLookup;
+	}
+	else {
+		m_radixTable.reset();
+		buildTree();
+		m_lookupMode = TreeLookup;
+	}
+}
+
+void SegmentIndex::build(LookupMode mode)
+{
+	m_radixTable.reset();
+	m_treeData.reset();
+	m_tree = nullptr;
+	if (mode == TreeLookup) {
+		buildTree();
+	}
+	else if (mode == RadixLookup) {
+		buildRadixTable();
+	}
+	m_lookupMode = mode;
+}
+
+size_t SegmentIndex::lowerBound(uint32_t key) const
+{
+	switch (m_lookupMode) {
+	case RadixLookup:
+		return radixLowerBound(key);
+	case TreeLookup:
+		return treeLowerBound(key);
+	default:
+		return std::lower_bound(m_keys.get(), m_keys.get() + m_blockCount, key) - m_keys.get();
+	}
+}
+
+void SegmentIndex::buildTree()
+{
+	m_treeDepth = 0;
+	while ((size_t(1) << m_treeDepth) - 1 < m_blockCount) {
+		m_treeDepth++;
+	}
+	size_t treeSize = size_t(1) << m_treeDepth;
+	// Align the tree to a cache line, so that the 16 great-great-grandchildren
+	// of a node, which are prefetched together, share one line.
+	m_treeData.reset(new uint32_t[treeSize + 16]);
+	m_tree = m_treeData.get() + (16 - (reinterpret_cast<uintptr_t>(m_treeData.get()) & 63) / sizeof(uint32_t)) % 16;
+	m_tree[0] = 0;
+	for (size_t node = 1; node < treeSize; node++) {
+		size_t rank = treeRank(node);
+		m_tree[node] = rank < m_blockCount ? m_keys[rank] : UINT32_MAX;
+	}
+}
+
+// Number of lookups that are interleaved in lowerBounds()
+static const size_t kLookupGroupSize = 8;
+
+void SegmentIndex::lowerBounds(const uint32_t *keys, size_t count, size_t *positions) const
+{
+	switch (m_lookupMode) {
+	case RadixLookup:
+		radixLowerBounds(keys, count, positions);
+		break;
+	case TreeLookup:
+		treeLowerBounds(keys, count, positions);
+		break;
+	default:
+		for (size_t i = 0; i < count; i++) {
+			positions[i] = lowerBound(keys[i]);
+		}
+		break;
+	}
+}
+
+// Position of the result, given the leaf where the descent ended.
+size_t SegmentIndex::treePosition(size_t leaf) const
+{
+	// Go back up to the last node where we went left, which is the result.
+	size_t node = leaf >> __builtin_ffsll(~leaf);
+	if (node == 0) {
+		return m_blockCount;
+	}
+	return std::min(treeRank(node), m_blockCount);
+}
+
+// Same as std::lower_bound over the keys, but with one cache miss per four
+// levels of the tree instead of one per level on large segments.
+size_t SegmentIndex::treeLowerBound(uint32_t key) const
+{
+	size_t treeSize = size_t(1) << m_treeDepth;
+	size_t node = 1;
+	while (node < treeSize) {
+		__builtin_prefetch(m_tree + node * 16);
+		node = 2 * node + (m_tree[node] < key);
+	}
+	return treePosition(node);
+}
+
+// All lookups of a group go down the tree one level at a time, so the
+// cache misses of up to kLookupGroupSize of them are in flight at once.
+void SegmentIndex::treeLowerBounds(const uint32_t *keys, size_t count, size_t *positions) const
+{
+	size_t nodes[kLookupGroupSize];
+	for (size_t start = 0; start < count; start += kLookupGroupSize) {
+		size_t n = std::min(count - start, kLookupGroupSize);
+		const uint32_t *groupKeys = keys + start;
+		std::fill(nodes, nodes + n, size_t(1));
+		for (int level = 0; level < m_treeDepth; level++) {
+			for (size_t i = 0; i < n; i++) {
+				__builtin_prefetch(m_tree + nodes[i] * 16);
+			}
+			for (size_t i = 0; i < n; i++) {
+				nodes[i] = 2 * nodes[i] + (m_tree[nodes[i]] < groupKeys[i]);
+			}
+		}
+		for (size_t i = 0; i < n; i++) {
+			positions[start + i] = treePosition(nodes[i]);
+		}
+	}
+}
+
+// Build the radix table and return the size of its largest range.
+size_t SegmentIndex::buildRadixTable()
+{
+	// About one to two table entries per block
+	int bits = 1;
+	while (bits < 24 && (size_t(1) << bits) < m_blockCount) {
+		bits++;
+	}
+	size_t tableSize = size_t(1) << bits;
+	m_radixShift = 32 - bits;
+	m_radixTable.reset(new uint32_t[tableSize + 1]);
+	size_t block = 0, maxRange = 0;
+	for (size_t prefix = 0; prefix <= tableSize; prefix++) {
+		size_t start = block;
+		while (block < m_blockCount && (m_keys[block] >> m_radixShift) < prefix) {
+			block++;
+		}
+		m_radixTable[prefix] = block;
+		maxRange = std::max(maxRange, block - start);
+	}
+	return maxRange;
+}
+
+// Exact lower bound, the binary search is limited to the blocks that
+// share the top bits with the key.
+size_t SegmentIndex::radixLowerBound(uint32_t key) const
+{
+	size_t prefix = key >> m_radixShift;
+	const uint32_t *keys = m_keys.get();
+	return std::lower_bound(keys + m_radixTable[prefix], keys + m_radixTable[prefix + 1], key) - keys;
+}
+
+// Loads the table entries of the whole group first, then the middle of
+// each key range, before doing the binary searches.
+void SegmentIndex::radixLowerBounds(const uint32_t *keys, size_t count, size_t *positions) const
+{
+	const uint32_t *blockKeys = m_keys.get();
+	size_t firstBlocks[kLookupGroupSize], lastBlocks[kLookupGroupSize];
+	for (size_t start = 0; start < count; start += kLookupGroupSize) {
+		size_t n = std::min(count - start, kLookupGroupSize);
+		const uint32_t *groupKeys = keys + start;
+		for (size_t i = 0; i < n; i++) {
+			__builtin_prefetch(m_radixTable.get() + (groupKeys[i] >> m_radixShift));
+		}
+		for (size_t i = 0; i < n; i++) {
+			size_t prefix = groupKeys[i] >> m_radixShift;
+			firstBlocks[i] = m_radixTable[prefix];
+			lastBlocks[i] = m_radixTable[prefix + 1];
+			__builtin_prefetch(blockKeys + (firstBlocks[i] + lastBlocks[i]) / 2);
+		}
+		for (size_t i = 0; i < n; i++) {
+			positions[start + i] = std::lower_bound(blockKeys + firstBlocks[i], blockKeys + lastBlocks[i], groupKeys[i]) - blockKeys;
+		}
+	}
+}
+
 bool SegmentIndex::search(uint32_t key, size_t *firstBlock, size_t *lastBlock)
 {
-	ssize_t pos = searchFirstSmaller(m_keys.get(), 0, m_blockCount, key);
+	return blockRange(lowerBound(key), key, firstBlock, lastBlock);
+}
+
+bool SegmentIndex::blockRange(size_t lowerBound, uint32_t key, size_t *firstBlock, size_t *lastBlock)
+{
+	ssize_t pos = ssize_t(lowerBound) - 1;
 	if (pos == -1) {
 		if (m_keys[0] > key) {
 			return false;
@@ -32,3 +229,35 @@ bool SegmentIndex::search(uint32_t key, size_t *firstBlock, size_t *lastBlock)
 	return true;
 }
 
+
+// Farther than this, a full lookup is cheaper than galloping.
+static const size_t kMaxGallopStep = 64;
+
+bool SegmentIndexCursor::search(uint32_t key, size_t *firstBlock, size_t *lastBlock)
+{
+	const uint32_t *keys = m_index->keys();
+	size_t blockCount = m_index->blockCount();
+	size_t pos = m_position;
+	if (pos < blockCount && keys[pos] < key) {
+		// Gallop forward until we pass the key, keys[lo] is always smaller
+		size_t lo = pos, step = 1;
+		size_t hi = lo + step;
+		while (hi < blockCount && keys[hi] < key && step <= kMaxGallopStep) {
+			lo = hi;
+			step *= 2;
+			hi = lo + step;
+		}
+		if (step > kMaxGallopStep) {
+			pos = m_index->lowerBound(key);
+		}
+		else {
+			pos = std::lower_bound(keys + lo + 1, keys + std::min(hi, blockCount), key) - keys;
+		}
+	}
+	else if (pos > 0 && keys[pos - 1] >= key) {
+		// The key is smaller than the previous one
+		pos = m_index->lowerBound(key);
+	}
+	m_position = pos;
+	return m_index->blockRange(pos, key, firstBlock, lastBlock);
+}
@@ -9,10 +9,43 @@
 
 namespace Acoustid {
 
+// Small Bloom filter over the keys of one block. Each key sets two bits
+// in one of the words, so checking a key needs only one word.
+struct BlockSketch
+{
+	static const int kWords = 4;
+
+	uint64_t words[kWords];
+
+	void clear()
+	{
+		memset(words, 0, sizeof(words));
+	}
+
+	void add(uint32_t key)
+	{
+		uint64_t hash = key * UINT64_C(0x9E3779B97F4A7C15);
+		words[hash >> 62] |= mask(hash);
+	}
+
+	bool mayContain(uint32_t key) const
+	{
+		uint64_t hash = key * UINT64_C(0x9E3779B97F4A7C15);
+		uint64_t m = mask(hash);
+		return (words[hash >> 62] & m) == m;
+	}
+
+private:
+	static uint64_t mask(uint64_t hash)
+	{
+		return (UINT64_C(1) << ((hash >> 56) & 63)) | (UINT64_C(1) << ((hash >> 50) & 63));
+	}
+};
+
 class SegmentIndex
 {
 public:
-	SegmentIndex(size_t blockCount);
+	SegmentIndex(size_t blockCount, bool hasSketches = false);
 	virtual ~SegmentIndex();
 
 	size_t blockCount() { return m_blockCount; }
@@ -24,12 +57,83 @@ public:
 		return m_keys[block];
 	}
 
+	// Block sketches, or NULL if the segment doesn't have them.
+	BlockSketch *sketches() { return m_sketches.get(); }
+
+	bool hasSketches() { return m_sketches.get() != nullptr; }
+
+	// Return false if the key is definitely not in the block.
+	bool mayContain(size_t block, uint32_t key)
+	{
+		return !m_sketches || m_sketches[block].mayContain(key);
+	}
+
+	enum LookupMode {
+		BinaryLookup, // binary search over the keys
+		TreeLookup, // binary search over an Eytzinger layout of the keys
+		RadixLookup, // table of key ranges indexed by the top bits of the key
+	};
+
+	LookupMode lookupMode() const { return m_lookupMode; }
+
+	// Build the lookup structures, must be called after the keys are filled
+	// in. Until then, search() does a plain binary search over the keys.
+	// Without a mode, the radix table is used if the keys are distributed
+	// evenly enough, and the tree otherwise.
+	void build();
+	void build(LookupMode mode);
+
 	bool search(uint32_t key, size_t *firstBlock, size_t *lastBlock);
 
+	// Position of the first block whose key is not smaller than the key
+	size_t lowerBound(uint32_t key) const;
+
+	// Same as lowerBound() for each of the keys. The lookups of a group of
+	// keys are interleaved, so that their cache misses overlap.
+	void lowerBounds(const uint32_t *keys, size_t count, size_t *positions) const;
+
+	// Range of blocks that can contain the key, given its lower bound
+	bool blockRange(size_t lowerBound, uint32_t key, size_t *firstBlock, size_t *lastBlock);
 
 private:
+	void buildTree();
+	size_t treeRank(size_t node) const;
+	size_t treePosition(size_t leaf) const;
+	size_t treeLowerBound(uint32_t key) const;
+	void treeLowerBounds(const uint32_t *keys, size_t count, size_t *positions) const;
+
+	size_t buildRadixTable();
+	size_t radixLowerBound(uint32_t key) const;
+	void radixLowerBounds(const uint32_t *keys, size_t count, size_t *positions) const;
+
 	size_t m_blockCount;
 	std::unique_ptr<uint32_t[]> m_keys;
+	std::unique_ptr<BlockSketch[]> m_sketches;
+	// Keys in Eytzinger (BFS) order of a perfect binary tree, the root is
+	// at index 1. Nodes past the last key are padded with UINT32_MAX.
+	std::unique_ptr<uint32_t[]> m_treeData;
+	uint32_t *m_tree;
+	int m_treeDepth;
+	// Keys with top bits p are in blocks [m_radixTable[p], m_radixTable[p+1])
+	std::unique_ptr<uint32_t[]> m_radixTable;
+	int m_radixShift;
+	LookupMode m_lookupMode;
+};
+
+// Looks up keys in increasing order. Each search continues from the
+// position of the previous one with an exponential search, which is much
+// cheaper than a full lookup if the keys are in nearby blocks.
+class SegmentIndexCursor
+{
+public:
+	SegmentIndexCursor(SegmentIndex *index) : m_index(index), m_position(0) { }
+
+	// Same as SegmentIndex::search()
+	bool search(uint32_t key, size_t *firstBlock, size_t *lastBlock);
+
+private:
+	SegmentIndex *m_index;
+	size_t m_position;
 };
 
 typedef QWeakPointer<SegmentIndex> SegmentIndexWeakPtr;
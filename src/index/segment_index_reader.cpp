@@ -7,8 +7,8 @@
 
 using namespace Acoustid;
 
-SegmentIndexReader::SegmentIndexReader(InputStream *input, size_t blockCount)
-	: m_input(input), m_blockCount(blockCount)
+SegmentIndexReader::SegmentIndexReader(InputStream *input, size_t blockCount, int version)
+	: m_input(input), m_blockCount(blockCount), m_version(version)
 {
 }
 
@@ -18,11 +18,22 @@ SegmentIndexReader::~SegmentIndexReader()
 
 SegmentIndexSharedPtr SegmentIndexReader::read()
 {
-	SegmentIndexSharedPtr index(new SegmentIndex(m_blockCount));
+	bool hasSketches = m_version >= SEGMENT_FORMAT_V3;
+	SegmentIndexSharedPtr index(new SegmentIndex(m_blockCount, hasSketches));
 	uint32_t *keys = index->keys();
 	for (size_t i = 0; i < m_blockCount; i++) {
 		*keys++ = m_input->readInt32();
 	}
+	if (hasSketches) {
+		BlockSketch *sketches = index->sketches();
+		for (size_t i = 0; i < m_blockCount; i++) {
+			for (size_t j = 0; j < BlockSketch::kWords; j++) {
+				uint64_t word = uint64_t(m_input->readInt32()) << 32;
+				sketches[i].words[j] = word | m_input->readInt32();
+			}
+		}
+	}
+	index->build();
 	return index;
 }
 
@@ -14,7 +14,7 @@ class InputStream;
 class SegmentIndexReader
 {
 public:
-	SegmentIndexReader(InputStream *input, size_t blockCount);
+	SegmentIndexReader(InputStream *input, size_t blockCount, int version = SEGMENT_FORMAT_VERSION);
 	virtual ~SegmentIndexReader();
 
 	SegmentIndexSharedPtr read();
@@ -22,6 +22,7 @@ public:
 private:
 	std::unique_ptr<InputStream> m_input;
 	size_t m_blockCount;
+	int m_version;
 };
 
 }
@@ -40,10 +40,47 @@ TEST_F(SegmentIndexReaderTest, Read)
 	stream->flush();
 
 	FSInputStream *input = FSInputStream::open(stream->fileName());
-	SegmentIndexSharedPtr index = SegmentIndexReader(input, 8).read();
+	SegmentIndexSharedPtr index = SegmentIndexReader(input, 8, SEGMENT_FORMAT_V1).read();
 
 	ASSERT_EQ(8, index->blockCount());
 	uint32_t expected0[] = { 2, 3, 4, 5, 6, 7, 8, 9 };
 	ASSERT_INTARRAY_EQ(expected0, index->keys(), 8);
+	ASSERT_FALSE(index->hasSketches());
+}
+
+TEST_F(SegmentIndexReaderTest, ReadV2)
+{
+	stream->writeInt32(2);
+	stream->writeInt32(3);
+	stream->flush();
+
+	FSInputStream *input = FSInputStream::open(stream->fileName());
+	SegmentIndexSharedPtr index = SegmentIndexReader(input, 2, SEGMENT_FORMAT_V2).read();
+
+	ASSERT_EQ(2, index->blockCount());
+	uint32_t expected0[] = { 2, 3 };
+	ASSERT_INTARRAY_EQ(expected0, index->keys(), 2);
+	ASSERT_FALSE(index->hasSketches());
+}
+
+TEST_F(SegmentIndexReaderTest, ReadV3)
+{
+	stream->writeInt32(2);
+	stream->writeInt32(3);
+	for (size_t i = 0; i < 2 * BlockSketch::kWords; i++) {
+		stream->writeInt32(0);
+		stream->writeInt32(i);
+	}
+	stream->flush();
+
+	FSInputStream *input = FSInputStream::open(stream->fileName());
+	SegmentIndexSharedPtr index = SegmentIndexReader(input, 2, SEGMENT_FORMAT_V3).read();
+
+	ASSERT_EQ(2, index->blockCount());
+	uint32_t expected0[] = { 2, 3 };
+	ASSERT_INTARRAY_EQ(expected0, index->keys(), 2);
+	ASSERT_TRUE(index->hasSketches());
+	ASSERT_EQ(1, index->sketches()[0].words[1]);
+	ASSERT_EQ(static_cast<uint64_t>(BlockSketch::kWords), index->sketches()[1].words[0]);
 }
 
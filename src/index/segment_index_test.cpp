@@ -88,3 +88,146 @@ TEST(SegmentIndexTest, Search)
 	EXPECT_EQ(7, lastBlock);
 }
 
+static void testLookupMode(SegmentIndex::LookupMode mode, uint32_t maxStep)
+{
+	uint32_t seed = 1;
+	size_t sizes[] = { 1, 2, 3, 7, 8, 9, 100, 1000, 4097 };
+	for (size_t n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+		size_t blockCount = sizes[n];
+		SegmentIndex index(blockCount);
+		SegmentIndex modeIndex(blockCount);
+		uint32_t key = 0;
+		for (size_t i = 0; i < blockCount; i++) {
+			seed = seed * 1103515245 + 12345;
+			// Some blocks start with the same key
+			key += (seed >> 16) % 4 ? (seed >> 16) % maxStep : 0;
+			index.keys()[i] = modeIndex.keys()[i] = key;
+		}
+		modeIndex.build(mode);
+		ASSERT_EQ(mode, modeIndex.lookupMode());
+		for (uint64_t k = 0; k <= uint64_t(key) + 1 && k <= UINT32_MAX; k += 1 + k % (maxStep / 100 + 7)) {
+			size_t firstBlock = 0, lastBlock = 0, modeFirstBlock = 0, modeLastBlock = 0;
+			bool found = index.search(k, &firstBlock, &lastBlock);
+			ASSERT_EQ(found, modeIndex.search(k, &modeFirstBlock, &modeLastBlock)) << "key " << k;
+			if (found) {
+				ASSERT_EQ(firstBlock, modeFirstBlock) << "key " << k;
+				ASSERT_EQ(lastBlock, modeLastBlock) << "key " << k;
+			}
+		}
+	}
+}
+
+TEST(SegmentIndexTest, SearchTree)
+{
+	testLookupMode(SegmentIndex::TreeLookup, 1000);
+}
+
+TEST(SegmentIndexTest, SearchRadix)
+{
+	testLookupMode(SegmentIndex::RadixLookup, 1000);
+	testLookupMode(SegmentIndex::RadixLookup, 1000000);
+}
+
+TEST(SegmentIndexTest, Cursor)
+{
+	uint32_t seed = 1;
+	SegmentIndex index(5000);
+	uint32_t key = 0;
+	for (size_t i = 0; i < index.blockCount(); i++) {
+		seed = seed * 1103515245 + 12345;
+		key += (seed >> 16) % 4 ? (seed >> 16) % 1000 : 0;
+		index.keys()[i] = key;
+	}
+	index.build();
+	// Both short and long jumps between the keys, and some going back
+	SegmentIndexCursor cursor(&index);
+	uint32_t k = 0;
+	for (size_t i = 0; i < 20000; i++) {
+		seed = seed * 1103515245 + 12345;
+		uint32_t r = seed >> 16;
+		k = r % 100 == 0 ? k - std::min(k, r) : k + (r % 10 ? r % 500 : r * 20);
+		size_t firstBlock = 0, lastBlock = 0, cursorFirstBlock = 0, cursorLastBlock = 0;
+		bool found = index.search(k, &firstBlock, &lastBlock);
+		ASSERT_EQ(found, cursor.search(k, &cursorFirstBlock, &cursorLastBlock)) << "key " << k;
+		if (found) {
+			ASSERT_EQ(firstBlock, cursorFirstBlock) << "key " << k;
+			ASSERT_EQ(lastBlock, cursorLastBlock) << "key " << k;
+		}
+	}
+}
+
+TEST(SegmentIndexTest, LowerBounds)
+{
+	SegmentIndex::LookupMode modes[] = { SegmentIndex::BinaryLookup, SegmentIndex::TreeLookup, SegmentIndex::RadixLookup };
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		uint32_t seed = 1;
+		SegmentIndex index(5000);
+		uint32_t key = 0;
+		for (size_t i = 0; i < index.blockCount(); i++) {
+			seed = seed * 1103515245 + 12345;
+			key += (seed >> 16) % 4 ? (seed >> 16) % 1000 : 0;
+			index.keys()[i] = key;
+		}
+		index.build(modes[m]);
+		// Not a multiple of the group size
+		std::vector<uint32_t> keys(1003);
+		for (size_t i = 0; i < keys.size(); i++) {
+			seed = seed * 1103515245 + 12345;
+			keys[i] = i % 7 ? (seed >> 8) % (key + 2) : index.keys()[(seed >> 16) % index.blockCount()];
+		}
+		std::vector<size_t> positions(keys.size());
+		index.lowerBounds(keys.data(), keys.size(), positions.data());
+		for (size_t i = 0; i < keys.size(); i++) {
+			size_t expected = std::lower_bound(index.keys(), index.keys() + index.blockCount(), keys[i]) - index.keys();
+			ASSERT_EQ(expected, positions[i]) << "mode " << modes[m] << ", key " << keys[i];
+		}
+	}
+}
+
+TEST(SegmentIndexTest, BuildPicksLookupMode)
+{
+	SegmentIndex index(1000);
+	for (size_t i = 0; i < 1000; i++) {
+		index.keys()[i] = i * 4000000;
+	}
+	ASSERT_EQ(SegmentIndex::BinaryLookup, index.lookupMode());
+	index.build();
+	ASSERT_EQ(SegmentIndex::RadixLookup, index.lookupMode());
+
+	// All keys share the top bits
+	for (size_t i = 0; i < 1000; i++) {
+		index.keys()[i] = i;
+	}
+	index.build();
+	ASSERT_EQ(SegmentIndex::TreeLookup, index.lookupMode());
+}
+
+
+TEST(SegmentIndexTest, BlockSketch)
+{
+	BlockSketch sketch;
+	sketch.clear();
+	uint32_t seed = 1;
+	for (int i = 0; i < 50; i++) {
+		seed = seed * 1103515245 + 12345;
+		sketch.add(seed);
+	}
+	seed = 1;
+	for (int i = 0; i < 50; i++) {
+		seed = seed * 1103515245 + 12345;
+		ASSERT_TRUE(sketch.mayContain(seed));
+	}
+	int falsePositives = 0;
+	for (int i = 0; i < 1000; i++) {
+		seed = seed * 1103515245 + 12345;
+		falsePositives += sketch.mayContain(seed);
+	}
+	ASSERT_LT(falsePositives, 250);
+
+	SegmentIndex index(2, true);
+	index.sketches()[0] = sketch;
+	index.sketches()[1].clear();
+	ASSERT_TRUE(index.mayContain(0, 1103527590));
+	ASSERT_FALSE(index.mayContain(1, 1103527590));
+	ASSERT_TRUE(SegmentIndex(2).mayContain(1, 1103527590));
+}
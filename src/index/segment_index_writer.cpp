@@ -21,6 +21,17 @@ void SegmentIndexWriter::addItem(uint32_t key)
 	m_output->writeInt32(key);
 }
 
+void SegmentIndexWriter::addSketches(const BlockSketch *sketches, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		for (size_t j = 0; j < BlockSketch::kWords; j++) {
+			uint64_t word = sketches[i].words[j];
+			m_output->writeInt32(word >> 32);
+			m_output->writeInt32(word);
+		}
+	}
+}
+
 void SegmentIndexWriter::close()
 {
 	m_output->flush();
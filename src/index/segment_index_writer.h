@@ -6,6 +6,7 @@
 
 #include <QList>
 #include "common.h"
+#include "segment_index.h"
 
 namespace Acoustid {
 
@@ -18,6 +19,10 @@ public:
 	virtual ~SegmentIndexWriter();
 
 	void addItem(uint32_t key);
+
+	// Write the sketches of all blocks, must be called after all keys are added.
+	void addSketches(const BlockSketch *sketches, size_t count);
+
 	void close();
 
 private:
@@ -1,14 +1,40 @@
 // Copyright (C) 2011  Lukas Lalinsky
 // Distributed under the MIT license, see the LICENSE file for details.
 
+#include "store/directory.h"
 #include "segment_info.h"
 
 using namespace Acoustid;
 
+SegmentFileRef::~SegmentFileRef()
+{
+	if (!m_obsolete) {
+		return;
+	}
+	for (int i = 0; i < m_files.size(); i++) {
+		qDebug() << "Deleting file" << m_files.at(i);
+		try {
+			m_dir->deleteFile(m_files.at(i));
+		}
+		catch (IOException& ex) {
+			qWarning() << "Failed to delete" << m_files.at(i) << ex.message();
+		}
+	}
+}
+
 QList<QString> SegmentInfo::files() const
 {
 	QList<QString> files;
 	files.append(indexFileName());
 	files.append(dataFileName());
+	if (hasFilter()) {
+		files.append(filterFileName());
+	}
+	if (hasHeavyKeys()) {
+		files.append(heavyKeysFileName());
+	}
+	if (hasPostings()) {
+		files.append(postingsFileName());
+	}
 	return files;
 }
@@ -4,13 +4,51 @@
 #ifndef ACOUSTID_SEGMENT_INFO_H_
 #define ACOUSTID_SEGMENT_INFO_H_
 
+#include <atomic>
 #include <QSharedData>
 #include <QSharedDataPointer>
+#include <QSharedPointer>
 #include "segment_index.h"
+#include "segment_filter.h"
+#include "segment_heavy_keys.h"
+#include "segment_postings.h"
+#include "store/input_file.h"
+#include "store/directory.h"
 #include "common.h"
 
 namespace Acoustid {
 
+// Owner of the files of a segment. Every snapshot of the index that
+// contains the segment holds a reference to it. Once the segment is
+// marked as obsolete, its files are deleted when the last reference
+// goes away.
+class SegmentFileRef
+{
+public:
+	SegmentFileRef(DirectorySharedPtr dir, const QList<QString>& files)
+		: m_dir(dir), m_files(files), m_obsolete(false) { }
+	~SegmentFileRef();
+
+	bool isObsolete() const
+	{
+		return m_obsolete;
+	}
+
+	void markObsolete()
+	{
+		m_obsolete = true;
+	}
+
+private:
+	ACOUSTID_DISABLE_COPY(SegmentFileRef);
+
+	DirectorySharedPtr m_dir;
+	QList<QString> m_files;
+	std::atomic<bool> m_obsolete;
+};
+
+typedef QSharedPointer<SegmentFileRef> SegmentFileRefSharedPtr;
+
 // Internal, do not use.
 class SegmentInfoData : public QSharedData
 {
@@ -20,6 +58,10 @@ public:
 		blockCount(blockCount),
 		lastKey(lastKey),
 		checksum(checksum),
+		version(SEGMENT_FORMAT_VERSION),
+		hasFilter(false),
+		hasHeavyKeys(false),
+		hasPostings(false),
 		index(index) { }
 	SegmentInfoData(const SegmentInfoData& other) :
 		QSharedData(other),
@@ -27,14 +69,32 @@ public:
 		blockCount(other.blockCount),
 		lastKey(other.lastKey),
 		checksum(other.checksum),
-		index(other.index) { }
+		version(other.version),
+		hasFilter(other.hasFilter),
+		hasHeavyKeys(other.hasHeavyKeys),
+		hasPostings(other.hasPostings),
+		index(other.index),
+		filter(other.filter),
+		heavyKeys(other.heavyKeys),
+		postings(other.postings),
+		dataFile(other.dataFile),
+		fileRef(other.fileRef) { }
 	~SegmentInfoData() { }
 
 	int id;
 	size_t blockCount;
 	uint32_t lastKey;
 	uint32_t checksum;
+	int version;
+	bool hasFilter;
+	bool hasHeavyKeys;
+	bool hasPostings;
 	SegmentIndexSharedPtr index;
+	SegmentFilterSharedPtr filter;
+	SegmentHeavyKeysSharedPtr heavyKeys;
+	SegmentPostingsSharedPtr postings;
+	InputFileSharedPtr dataFile;
+	SegmentFileRefSharedPtr fileRef;
 };
 
 class SegmentInfo
@@ -58,6 +118,21 @@ public:
 		return name() + ".fid";
 	}
 
+	QString filterFileName() const
+	{
+		return name() + ".fif";
+	}
+
+	QString heavyKeysFileName() const
+	{
+		return name() + ".fih";
+	}
+
+	QString postingsFileName() const
+	{
+		return name() + ".fip";
+	}
+
 	void setId(int id)
 	{
 		d->id = id;
@@ -98,6 +173,17 @@ public:
 		d->blockCount = blockCount;
 	}
 
+	// Format of the segment data file
+	int version() const
+	{
+		return d->version;
+	}
+
+	void setVersion(int version)
+	{
+		d->version = version;
+	}
+
 	SegmentIndexSharedPtr index() const
 	{
 		return d->index;
@@ -108,6 +194,106 @@ public:
 		d->index = index;
 	}
 
+	// Whether the segment has a key filter file
+	bool hasFilter() const
+	{
+		return d->hasFilter;
+	}
+
+	void setHasFilter(bool hasFilter)
+	{
+		d->hasFilter = hasFilter;
+	}
+
+	// Key filter, or NULL if it's not loaded
+	SegmentFilterSharedPtr filter() const
+	{
+		return d->filter;
+	}
+
+	void setFilter(SegmentFilterSharedPtr filter)
+	{
+		d->filter = filter;
+	}
+
+	// Return false if the key is definitely not in the segment.
+	bool mayContain(uint32_t key) const
+	{
+		return !d->filter || d->filter->mayContain(key);
+	}
+
+	// Whether the segment has a file with frequencies of the heavy keys
+	bool hasHeavyKeys() const
+	{
+		return d->hasHeavyKeys;
+	}
+
+	void setHasHeavyKeys(bool hasHeavyKeys)
+	{
+		d->hasHeavyKeys = hasHeavyKeys;
+	}
+
+	// Frequencies of the heavy keys, or NULL if they are not loaded
+	SegmentHeavyKeysSharedPtr heavyKeys() const
+	{
+		return d->heavyKeys;
+	}
+
+	void setHeavyKeys(SegmentHeavyKeysSharedPtr heavyKeys)
+	{
+		d->heavyKeys = heavyKeys;
+	}
+
+	// Number of documents with the key if it's one of the heavy keys, zero otherwise
+	uint32_t keyFrequency(uint32_t key) const
+	{
+		return d->heavyKeys ? d->heavyKeys->frequency(key) : 0;
+	}
+
+	// Whether the segment has a file with separate posting lists of the keys with the most items
+	bool hasPostings() const
+	{
+		return d->hasPostings;
+	}
+
+	void setHasPostings(bool hasPostings)
+	{
+		d->hasPostings = hasPostings;
+	}
+
+	// Separate posting lists, or NULL if they are not loaded
+	SegmentPostingsSharedPtr postings() const
+	{
+		return d->postings;
+	}
+
+	void setPostings(SegmentPostingsSharedPtr postings)
+	{
+		d->postings = postings;
+	}
+
+	// Data file shared by all readers of the segment, or NULL if it's not open
+	InputFileSharedPtr dataFile() const
+	{
+		return d->dataFile;
+	}
+
+	void setDataFile(InputFileSharedPtr dataFile)
+	{
+		d->dataFile = dataFile;
+	}
+
+	// Owner of the segment files, or NULL if nobody manages them
+	SegmentFileRefSharedPtr fileRef() const
+	{
+		return d->fileRef;
+	}
+
+	void setFileRef(SegmentFileRefSharedPtr fileRef)
+	{
+		d->fileRef = fileRef;
+	}
+
 	QList<QString> files() const;
 
 private:
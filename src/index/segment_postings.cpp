@@ -0,0 +1,183 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include "store/input_stream.h"
+#include "store/output_stream.h"
+#include "segment_postings.h"
+
+using namespace Acoustid;
+
+const size_t SegmentPostings::kChunkSize;
+const size_t SegmentPostings::kBitmapChunkWords;
+
+SegmentPostings::SegmentPostings()
+{
+}
+
+SegmentPostings::~SegmentPostings()
+{
+}
+
+size_t SegmentPostings::lowerBound(uint32_t key, size_t start) const
+{
+	std::vector<Entry>::const_iterator it = std::lower_bound(m_entries.begin() + std::min(start, m_entries.size()), m_entries.end(), key, [](const Entry &entry, uint32_t key) {
+		return entry.key < key;
+	});
+	return it - m_entries.begin();
+}
+
+size_t SegmentPostings::dataSize(const uint32_t *keys, size_t length) const
+{
+	size_t size = 0, position = 0;
+	for (size_t i = 0; i < length; i++) {
+		if (i > 0 && keys[i] == keys[i - 1]) {
+			continue;
+		}
+		position = lowerBound(keys[i], position);
+		if (position >= m_entries.size()) {
+			break;
+		}
+		if (m_entries[position].key == keys[i]) {
+			size += dataSize(position);
+		}
+	}
+	return size;
+}
+
+void SegmentPostings::add(uint32_t key, const uint32_t *values, size_t length)
+{
+	assert(m_entries.empty() || key > m_entries.back().key);
+	assert(length > 0);
+	Entry entry = { key, uint32_t(length), m_data.size(), 0, false };
+
+	// Each frame has the bit width and the packed deltas, the first
+	// delta is from zero.
+	size_t frameCount = (length + kChunkSize - 1) / kChunkSize;
+	std::vector<uint32_t> deltas(frameCount * kChunkSize, 0);
+	std::vector<int> widths(frameCount, 0);
+	size_t packedWords = 0;
+	uint32_t last = 0;
+	for (size_t i = 0; i < length; i++) {
+		assert(i == 0 || values[i] > last);
+		deltas[i] = values[i] - last;
+		widths[i / kChunkSize] = std::max(widths[i / kChunkSize], bitWidth(deltas[i]));
+		last = values[i];
+	}
+	for (size_t i = 0; i < frameCount; i++) {
+		packedWords += 1 + 4 * widths[i];
+	}
+
+	uint32_t base = values[0] & ~31u;
+	size_t bitmapWords = 1 + (values[length - 1] - base) / 32 + 1;
+	if (bitmapWords <= packedWords) {
+		entry.bitmap = true;
+		entry.words = bitmapWords;
+		m_data.resize(m_data.size() + bitmapWords, 0);
+		uint32_t *data = m_data.data() + entry.offset;
+		data[0] = base;
+		for (size_t i = 0; i < length; i++) {
+			uint32_t bit = values[i] - base;
+			data[1 + bit / 32] |= 1u << (bit % 32);
+		}
+	}
+	else {
+		entry.words = packedWords;
+		m_data.resize(m_data.size() + packedWords, 0);
+		uint32_t *data = m_data.data() + entry.offset;
+		for (size_t i = 0; i < frameCount; i++) {
+			*data++ = widths[i];
+			packBits128(deltas.data() + i * kChunkSize, widths[i], data);
+			data += 4 * widths[i];
+		}
+	}
+	m_entries.push_back(entry);
+}
+
+size_t SegmentPostings::readBitmap(const uint32_t *data, size_t words, uint32_t base, uint32_t *values)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < words; i++) {
+		uint32_t bits = data[i];
+		while (bits) {
+			values[count++] = base + 32 * i + __builtin_ctz(bits);
+			bits &= bits - 1;
+		}
+	}
+	return count;
+}
+
+// Check that the encoded values match the entry, so that reading them
+// can't go out of bounds.
+bool SegmentPostings::isValid(const Entry &entry, const uint32_t *data)
+{
+	if (!entry.count || !entry.words) {
+		return false;
+	}
+	if (entry.bitmap) {
+		size_t count = 0;
+		for (size_t i = 1; i < entry.words; i++) {
+			count += __builtin_popcount(data[i]);
+		}
+		return count == entry.count && uint64_t(data[0]) + 32 * (entry.words - 1) <= uint64_t(UINT32_MAX) + 1;
+	}
+	size_t offset = 0;
+	size_t frameCount = (entry.count + kChunkSize - 1) / kChunkSize;
+	for (size_t i = 0; i < frameCount; i++) {
+		if (offset >= entry.words || data[offset] > 32) {
+			return false;
+		}
+		offset += 1 + 4 * data[offset];
+	}
+	return offset == entry.words;
+}
+
+void SegmentPostings::save(OutputStream *output) const
+{
+	output->writeVInt32(m_entries.size());
+	uint32_t lastKey = 0;
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		const Entry &entry = m_entries[i];
+		output->writeVInt32(entry.key - lastKey);
+		output->writeVInt32(entry.count);
+		output->writeVInt32(entry.words);
+		output->writeByte(entry.bitmap ? 1 : 0);
+		lastKey = entry.key;
+	}
+	for (size_t i = 0; i < m_data.size(); i++) {
+		output->writeInt32(m_data[i]);
+	}
+	output->flush();
+}
+
+SegmentPostingsSharedPtr SegmentPostings::load(InputStream *input)
+{
+	SegmentPostingsSharedPtr postings(new SegmentPostings());
+	size_t size = input->readVInt32();
+	postings->m_entries.resize(size);
+	uint32_t lastKey = 0;
+	size_t dataSize = 0;
+	for (size_t i = 0; i < size; i++) {
+		Entry &entry = postings->m_entries[i];
+		entry.key = lastKey + input->readVInt32();
+		if (i > 0 && entry.key <= lastKey) {
+			throw CorruptIndexException("posting list keys are not sorted");
+		}
+		entry.count = input->readVInt32();
+		entry.words = input->readVInt32();
+		entry.bitmap = input->readByte() != 0;
+		entry.offset = dataSize;
+		dataSize += entry.words;
+		lastKey = entry.key;
+	}
+	postings->m_data.resize(dataSize);
+	for (size_t i = 0; i < dataSize; i++) {
+		postings->m_data[i] = input->readInt32();
+	}
+	for (size_t i = 0; i < size; i++) {
+		const Entry &entry = postings->m_entries[i];
+		if (!isValid(entry, postings->m_data.data() + entry.offset)) {
+			throw CorruptIndexException("invalid posting list");
+		}
+	}
+	return postings;
+}
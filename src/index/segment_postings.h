@@ -0,0 +1,128 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_INDEX_SEGMENT_POSTINGS_H_
+#define ACOUSTID_INDEX_SEGMENT_POSTINGS_H_
+
+#include <algorithm>
+#include <vector>
+#include <QSharedPointer>
+#include "common.h"
+#include "util/bitpack.h"
+
+namespace Acoustid {
+
+class InputStream;
+class OutputStream;
+
+// Posting lists of the keys with the most items in a segment. The values
+// of these keys are stored here instead of in the data blocks, so that
+// they don't take whole runs of blocks with an index entry for each. A
+// list is stored as a bitmap if its values are dense, otherwise as
+// bit-packed deltas in frames of 128 values.
+class SegmentPostings
+{
+public:
+	SegmentPostings();
+	virtual ~SegmentPostings();
+
+	// Maximum number of values passed to the function by read()
+	static const size_t kChunkSize = 128;
+
+	// Number of keys
+	size_t size() const { return m_entries.size(); }
+
+	uint32_t key(size_t i) const { return m_entries[i].key; }
+
+	// Number of values of the key at position i
+	size_t itemCount(size_t i) const { return m_entries[i].count; }
+
+	// Size of the encoded values of the key at position i in bytes
+	size_t dataSize(size_t i) const { return m_entries[i].words * sizeof(uint32_t); }
+
+	// Size of the encoded values of the keys in bytes, the keys must be
+	// sorted, repeated keys are only counted once
+	size_t dataSize(const uint32_t *keys, size_t length) const;
+
+	// Whether the values of the key at position i are stored as a bitmap
+	bool isBitmap(size_t i) const { return m_entries[i].bitmap; }
+
+	// Position of the first key not less than the key, looking from the
+	// position start, or size() if there is no such key
+	size_t lowerBound(uint32_t key, size_t start = 0) const;
+
+	// Add the values of a key, which must be sorted and unique. The keys
+	// must be added in ascending order.
+	void add(uint32_t key, const uint32_t *values, size_t length);
+
+	// Decode the values of the key at position i, calling func(values, count)
+	// for each chunk of at most kChunkSize values.
+	template <typename Func>
+	void read(size_t i, Func func) const;
+
+	void save(OutputStream *output) const;
+	static QSharedPointer<SegmentPostings> load(InputStream *input);
+
+private:
+	ACOUSTID_DISABLE_COPY(SegmentPostings);
+
+	// Bitmap words read at once, so that a chunk has at most kChunkSize values
+	static const size_t kBitmapChunkWords = kChunkSize / 32;
+
+	struct Entry
+	{
+		uint32_t key;
+		uint32_t count;
+		size_t offset;
+		size_t words;
+		bool bitmap;
+	};
+
+	static size_t readBitmap(const uint32_t *data, size_t words, uint32_t base, uint32_t *values);
+	static bool isValid(const Entry &entry, const uint32_t *data);
+
+	std::vector<Entry> m_entries;
+	// Bitmaps start with the value of the first bit, bit-packed lists are
+	// frames with the bit width followed by the packed deltas.
+	std::vector<uint32_t> m_data;
+};
+
+template <typename Func>
+void SegmentPostings::read(size_t i, Func func) const
+{
+	uint32_t values[kChunkSize];
+	const Entry &entry = m_entries[i];
+	const uint32_t *data = m_data.data() + entry.offset;
+	const uint32_t *end = data + entry.words;
+	if (entry.bitmap) {
+		uint32_t base = *data++;
+		while (data < end) {
+			size_t words = std::min(size_t(end - data), kBitmapChunkWords);
+			size_t count = readBitmap(data, words, base, values);
+			if (count) {
+				func(values, count);
+			}
+			data += words;
+			base += 32 * words;
+		}
+	}
+	else {
+		uint32_t last = 0;
+		size_t remaining = entry.count;
+		while (remaining) {
+			int width = *data++;
+			last = unpackDeltas128(data, width, last, values);
+			data += 4 * width;
+			size_t count = std::min(remaining, kChunkSize);
+			func(values, count);
+			remaining -= count;
+		}
+	}
+}
+
+typedef QWeakPointer<SegmentPostings> SegmentPostingsWeakPtr;
+typedef QSharedPointer<SegmentPostings> SegmentPostingsSharedPtr;
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "util/test_utils.h"
+#include "store/ram_directory.h"
+#include "store/input_stream.h"
+#include "store/output_stream.h"
+#include "segment_postings.h"
+
+using namespace Acoustid;
+
+static std::vector<uint32_t> readValues(const SegmentPostings &postings, size_t i)
+{
+	std::vector<uint32_t> values;
+	postings.read(i, [&values](const uint32_t *chunk, size_t count) {
+		ASSERT_GE(128, count);
+		values.insert(values.end(), chunk, chunk + count);
+	});
+	return values;
+}
+
+// Values of key i, some dense and some sparse
+static std::vector<uint32_t> makeValues(size_t i)
+{
+	std::vector<uint32_t> values;
+	uint32_t value = i * 1000, seed = i + 1;
+	for (size_t j = 0; j < 100 + 150 * i; j++) {
+		seed = seed * 1103515245 + 12345;
+		value += i % 2 ? 1 + (seed >> 16) % 2 : 1 + (seed >> 8) % 100000;
+		values.push_back(value);
+	}
+	return values;
+}
+
+TEST(SegmentPostingsTest, AddAndRead)
+{
+	SegmentPostings postings;
+	for (size_t i = 0; i < 6; i++) {
+		std::vector<uint32_t> values = makeValues(i);
+		postings.add(10 + i * 10, values.data(), values.size());
+	}
+	ASSERT_EQ(6, postings.size());
+	for (size_t i = 0; i < 6; i++) {
+		std::vector<uint32_t> values = makeValues(i);
+		ASSERT_EQ(10 + i * 10, postings.key(i));
+		ASSERT_EQ(values.size(), postings.itemCount(i));
+		ASSERT_EQ(i % 2 == 1, postings.isBitmap(i)) << "key " << i;
+		ASSERT_TRUE(values == readValues(postings, i)) << "key " << i;
+	}
+	ASSERT_EQ(0, postings.lowerBound(5));
+	ASSERT_EQ(1, postings.lowerBound(20));
+	ASSERT_EQ(2, postings.lowerBound(21));
+	ASSERT_EQ(3, postings.lowerBound(21, 3));
+	ASSERT_EQ(6, postings.lowerBound(61));
+
+	uint32_t keys[] = { 5, 20, 20, 25, 60, 70 };
+	ASSERT_EQ(postings.dataSize(1) + postings.dataSize(5), postings.dataSize(keys, 6));
+	ASSERT_EQ(0, postings.dataSize(keys, 1));
+}
+
+TEST(SegmentPostingsTest, ExtremeValues)
+{
+	SegmentPostings postings;
+	uint32_t values1[] = { 0, UINT32_MAX };
+	uint32_t values2[] = { UINT32_MAX - 2, UINT32_MAX - 1, UINT32_MAX };
+	postings.add(1, values1, 2);
+	postings.add(2, values2, 3);
+	ASSERT_FALSE(postings.isBitmap(0));
+	ASSERT_TRUE(postings.isBitmap(1));
+	ASSERT_TRUE(std::vector<uint32_t>(values1, values1 + 2) == readValues(postings, 0));
+	ASSERT_TRUE(std::vector<uint32_t>(values2, values2 + 3) == readValues(postings, 1));
+}
+
+TEST(SegmentPostingsTest, SaveAndLoad)
+{
+	RAMDirectory dir;
+	SegmentPostings postings;
+	for (size_t i = 0; i < 6; i++) {
+		std::vector<uint32_t> values = makeValues(i);
+		postings.add(i * 7, values.data(), values.size());
+	}
+	{
+		std::unique_ptr<OutputStream> output(dir.createFile("segment_0.fip"));
+		postings.save(output.get());
+	}
+	std::unique_ptr<InputStream> input(dir.openFile("segment_0.fip"));
+	SegmentPostingsSharedPtr postings2 = SegmentPostings::load(input.get());
+	ASSERT_EQ(6, postings2->size());
+	for (size_t i = 0; i < 6; i++) {
+		ASSERT_EQ(i * 7, postings2->key(i));
+		ASSERT_EQ(postings.isBitmap(i), postings2->isBitmap(i));
+		ASSERT_EQ(postings.dataSize(i), postings2->dataSize(i));
+		ASSERT_TRUE(makeValues(i) == readValues(*postings2, i)) << "key " << i;
+	}
+}
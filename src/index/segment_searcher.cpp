@@ -2,14 +2,22 @@
 // Distributed under the MIT license, see the LICENSE file for details.
 
 #include <algorithm>
+#include "util/intersect.h"
+#include "util/search_utils.h"
 #include "collector.h"
 #include "segment_data_reader.h"
+#include "index_utils.h"
 #include "segment_searcher.h"
 
 using namespace Acoustid;
 
 SegmentSearcher::SegmentSearcher(SegmentIndexSharedPtr index, SegmentDataReader *dataReader, uint32_t lastKey)
-	: m_index(index), m_dataReader(dataReader), m_lastKey(lastKey)
+	: m_index(index), m_dataReader(dataReader), m_lastKey(lastKey),
+	  m_blockKeys(new uint32_t[dataReader->blockSize()]),
+	  m_blockValues(new uint32_t[dataReader->blockSize()]),
+	  m_keyMatches(new uint32_t[dataReader->blockSize()]),
+	  m_termMatches(new uint32_t[dataReader->blockSize()]),
+	  m_hasDeadline(false), m_truncated(false)
 {
 }
 
@@ -17,17 +25,110 @@ SegmentSearcher::~SegmentSearcher()
 {
 }
 
-void SegmentSearcher::search(uint32_t *fingerprint, size_t length, Collector *collector)
+// Number of blocks read between checks of the deadline
+static const size_t kDeadlineCheckBlocks = 16;
+
+bool SegmentSearcher::deadlinePassed()
+{
+	if (m_hasDeadline && Clock::now() >= m_deadline) {
+		m_truncated = true;
+	}
+	return m_truncated;
+}
+
+// Below this, the whole segment index is in the CPU cache and the cursor
+// is cheaper than looking up terms ahead.
+static const size_t kMinLookaheadBlocks = 1024;
+
+// Number of terms looked up at once
+static const size_t kLookaheadSize = 16;
+
+// The keys of the posting lists are not in the blocks, so the terms are
+// looked up in them separately. Returns false if the deadline passed.
+template <typename MatchFunc>
+bool SegmentSearcher::searchPostings(const uint32_t *terms, size_t length, MatchFunc match)
+{
+	size_t position = 0;
+	for (size_t i = 0; i < length; i++) {
+		if (i > 0 && terms[i] == terms[i - 1]) {
+			// Like in the blocks, only the first of equal terms gets the hits.
+			continue;
+		}
+		position = m_postings->lowerBound(terms[i], position);
+		if (position >= m_postings->size()) {
+			break;
+		}
+		if (m_postings->key(position) != terms[i]) {
+			continue;
+		}
+		// Each list is as long as many blocks, so the deadline is checked for every one.
+		if (deadlinePassed()) {
+			return false;
+		}
+		m_postings->read(position, [i, &match](const uint32_t *values, size_t count) {
+			for (size_t k = 0; k < count; k++) {
+				match(i, values[k]);
+			}
+		});
+		m_stats.items += m_postings->itemCount(position);
+		m_stats.hits += m_postings->itemCount(position);
+		m_stats.bytes += m_postings->dataSize(position);
+	}
+	return true;
+}
+
+template <typename MatchFunc>
+void SegmentSearcher::searchTerms(const uint32_t *terms, size_t length, MatchFunc match)
 {
+	// The terms are sorted, so each index lookup starts where the last one ended.
+	SegmentIndexCursor cursor(m_index.data());
+	// On large segments, the following terms are looked up together, so
+	// that their cache misses overlap, and the blocks found are prefetched
+	// while the current ones are decoded.
+	bool lookahead = m_index->blockCount() >= kMinLookaheadBlocks;
+	size_t lookaheadPositions[kLookaheadSize];
+	size_t lookaheadStart = 0, lookaheadEnd = 0;
 	size_t i = 0, block = 0, lastBlock = SIZE_MAX;
+	size_t blocksRead = 0;
+	m_truncated = false;
+	m_stats = SearchStats();
+	if (deadlinePassed()) {
+		return;
+	}
+	if (m_postings && !searchPostings(terms, length, match)) {
+		return;
+	}
+	if (!m_index->blockCount()) {
+		return;
+	}
 	while (i < length) {
 		if (block > lastBlock || lastBlock == SIZE_MAX) {
 			size_t localFirstBlock, localLastBlock;
-			if (fingerprint[i] > m_lastKey) {
+			if (terms[i] > m_lastKey) {
 				// All following items are larger than the last segment's key.
 				return;
 			}
-			if (m_index->search(fingerprint[i], &localFirstBlock, &localLastBlock)) {
+			bool found;
+			m_stats.lookups++;
+			if (lookahead) {
+				if (i >= lookaheadEnd) {
+					lookaheadStart = i;
+					lookaheadEnd = std::min(length, i + kLookaheadSize);
+					m_index->lowerBounds(terms + lookaheadStart, lookaheadEnd - lookaheadStart, lookaheadPositions);
+					for (size_t k = 0; k < lookaheadEnd - lookaheadStart; k++) {
+						size_t position = lookaheadPositions[k];
+						__builtin_prefetch(m_index->keys() + position);
+						if (position > block) {
+							m_dataReader->prefetchBlock(position - 1);
+						}
+					}
+				}
+				found = m_index->blockRange(lookaheadPositions[i - lookaheadStart], terms[i], &localFirstBlock, &localLastBlock);
+			}
+			else {
+				found = cursor.search(terms[i], &localFirstBlock, &localLastBlock);
+			}
+			if (found) {
 				if (block > localLastBlock) {
 					// We already searched this block and the fingerprint item was not found.
 					i++;
@@ -44,28 +145,96 @@ void SegmentSearcher::search(uint32_t *fingerprint, size_t length, Collector *co
 			}
 		}
 		uint32_t firstKey = m_index->key(block);
-		uint32_t lastKey = block + 1 < m_index->blockCount() ? m_index->key(block + 1) : m_lastKey + 1;
-		std::unique_ptr<BlockDataIterator> blockData(m_dataReader->readBlock(block, firstKey));
-		while (blockData->next()) {
-			uint32_t key = blockData->key();
-			if (key >= fingerprint[i]) {
-				while (key > fingerprint[i]) {
-					i++;
-					if (i >= length) {
-						return;
-					}
-					else if (lastKey < fingerprint[i]) {
-						// There are no longer any items in this block that we could match.
-						goto nextBlock;
-					}
-				}
-				if (key == fingerprint[i]) {
-					collector->collect(blockData->value());
+		// Terms from i to end can be in the block
+		uint32_t maxKey = block + 1 < m_index->blockCount() ? m_index->key(block + 1) : m_lastKey;
+		size_t end = scanFirstGreater<const uint32_t>(terms, i, length, maxKey);
+		if (m_index->hasSketches()) {
+			// Don't decode the block if none of the terms that could be in it are there.
+			bool mayMatch = false;
+			for (size_t k = i; k < end; k++) {
+				if (m_index->mayContain(block, terms[k])) {
+					mayMatch = true;
+					break;
 				}
 			}
+			if (!mayMatch) {
+				block++;
+				continue;
+			}
+		}
+		if (m_hasDeadline && ++blocksRead % kDeadlineCheckBlocks == 0 && deadlinePassed()) {
+			return;
+		}
+		size_t itemCount = m_dataReader->readBlockKeys(block, firstKey, m_blockKeys.get());
+		m_stats.blocks++;
+		m_stats.items += itemCount;
+		m_stats.bytes += m_dataReader->blockSize();
+		size_t matchCount = intersectSorted(m_blockKeys.get(), itemCount, terms + i, end - i, m_keyMatches.get(), m_termMatches.get());
+		if (matchCount) {
+			// Values are only decoded for blocks that have any matches.
+			m_dataReader->readBlockValues(m_blockKeys.get(), m_blockValues.get());
+			for (size_t k = 0; k < matchCount; k++) {
+				match(i + m_termMatches[k], m_blockValues[m_keyMatches[k]]);
+			}
+			m_stats.hits += matchCount;
+		}
+		if (itemCount) {
+			// Terms smaller than the last key can't be in the following blocks.
+			i = std::lower_bound(terms + i, terms + end, m_blockKeys[itemCount - 1]) - terms;
 		}
-	nextBlock:
 		block++;
 	}
 }
 
+void SegmentSearcher::search(uint32_t *fingerprint, size_t length, Collector *collector)
+{
+	searchTerms(fingerprint, length,
+		[collector](size_t i, uint32_t value) { collector->collect(value); });
+}
+
+void SegmentSearcher::searchMany(const uint64_t *terms, size_t length, Collector **collectors)
+{
+	m_terms.resize(length);
+	for (size_t i = 0; i < length; i++) {
+		m_terms[i] = unpackItemKey(terms[i]);
+	}
+	searchTerms(m_terms.data(), length,
+		[terms, length, collectors](size_t i, uint32_t value) {
+			// The same item can be in multiple fingerprints, pass the hit to all of them.
+			uint32_t key = unpackItemKey(terms[i]);
+			for (size_t j = i; j < length && unpackItemKey(terms[j]) == key; j++) {
+				collectors[unpackItemValue(terms[j])]->collect(value);
+			}
+		});
+}
+
+std::vector<size_t> SegmentSearcher::partition(const uint32_t *fingerprint, size_t length, size_t maxParts)
+{
+	std::vector<size_t> starts(1, 0);
+	if (maxParts <= 1 || !length) {
+		return starts;
+	}
+	// Work before each term, in blocks. Posting lists count as the number
+	// of blocks their data would fill.
+	size_t blockCount = m_index->blockCount();
+	std::vector<size_t> work(length);
+	size_t postingsBlocks = 0;
+	for (size_t i = 0; i < length; i++) {
+		work[i] = (blockCount ? m_index->lowerBound(fingerprint[i]) : 0) + postingsBlocks;
+		if (m_postings && (i == 0 || fingerprint[i] != fingerprint[i - 1])) {
+			postingsBlocks += m_postings->dataSize(fingerprint + i, 1) / m_dataReader->blockSize();
+		}
+	}
+	size_t totalWork = blockCount + postingsBlocks;
+	for (size_t i = 1; i < maxParts; i++) {
+		size_t start = std::lower_bound(work.begin(), work.end(), totalWork * i / maxParts) - work.begin();
+		// Equal terms must be in the same part, only the first one gets the hits
+		while (start > 0 && start < length && fingerprint[start] == fingerprint[start - 1]) {
+			start--;
+		}
+		if (start > starts.back() && start < length) {
+			starts.push_back(start);
+		}
+	}
+	return starts;
+}
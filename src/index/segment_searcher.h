@@ -4,8 +4,12 @@
 #ifndef ACOUSTID_INDEX_SEGMENT_SEARCHER_H_
 #define ACOUSTID_INDEX_SEGMENT_SEARCHER_H_
 
+#include <chrono>
+#include <vector>
 #include "common.h"
 #include "segment_index.h"
+#include "segment_postings.h"
+#include "search_stats.h"
 
 namespace Acoustid {
 
@@ -25,10 +29,68 @@ public:
 	 */
 	void search(uint32_t *fingerprint, size_t length, Collector *collector);
 
+	/**
+	 * Search for multiple fingerprints in one pass over the segment.
+	 *
+	 * The terms are packed items with the fingerprint item as key and the
+	 * number of the collector as value. They must be sorted and unique.
+	 */
+	void searchMany(const uint64_t *terms, size_t length, Collector **collectors);
+
+	/**
+	 * Split the fingerprint into at most maxParts disjoint key ranges,
+	 * so that the parts can be searched independently and have roughly
+	 * the same number of blocks and posting list data to read. Returns
+	 * the offset at which each part starts.
+	 *
+	 * The fingerprint must be sorted.
+	 */
+	std::vector<size_t> partition(const uint32_t *fingerprint, size_t length, size_t maxParts);
+
+	// Separate posting lists of the segment, searched before the blocks
+	void setPostings(SegmentPostingsSharedPtr postings) { m_postings = postings; }
+
+	typedef std::chrono::steady_clock Clock;
+
+	// Searches stop when the deadline passes, keeping the hits collected
+	// so far. It's checked before the search, every few blocks and before
+	// each posting list.
+	void setDeadline(Clock::time_point deadline)
+	{
+		m_deadline = deadline;
+		m_hasDeadline = true;
+	}
+
+	// Whether the last search was stopped by the deadline
+	bool isTruncated() const { return m_truncated; }
+
+	// Work done by the last search, the segment count is not set
+	const SearchStats &stats() const { return m_stats; }
+
 private:
+	bool deadlinePassed();
+
+	template <typename MatchFunc>
+	void searchTerms(const uint32_t *terms, size_t length, MatchFunc match);
+
+	template <typename MatchFunc>
+	bool searchPostings(const uint32_t *terms, size_t length, MatchFunc match);
+
 	SegmentIndexSharedPtr m_index;
 	std::unique_ptr<SegmentDataReader> m_dataReader;
+	SegmentPostingsSharedPtr m_postings;
 	uint32_t m_lastKey;
+	std::unique_ptr<uint32_t[]> m_blockKeys;
+	std::unique_ptr<uint32_t[]> m_blockValues;
+	// Positions of the block keys and terms that match
+	std::unique_ptr<uint32_t[]> m_keyMatches;
+	std::unique_ptr<uint32_t[]> m_termMatches;
+	// Keys of the terms passed to searchMany()
+	std::vector<uint32_t> m_terms;
+	Clock::time_point m_deadline;
+	bool m_hasDeadline;
+	bool m_truncated;
+	SearchStats m_stats;
 };
 
 }
@@ -20,6 +20,11 @@ void TopHitsCollector::collect(uint32_t id)
 	m_counts[id] = m_counts[id] + 1;
 }
 
+void TopHitsCollector::collectMany(uint32_t id, unsigned int count)
+{
+	m_counts[id] += count;
+}
+
 struct CompareByCount
 {
 	CompareByCount(const QHash<uint32_t, unsigned int> &counts) : m_counts(counts) {}
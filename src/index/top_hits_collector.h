@@ -31,6 +31,7 @@ public:
 	TopHitsCollector(size_t numHits, int topScorePercent = 0);
 	~TopHitsCollector();
 	void collect(uint32_t id);
+	void collectMany(uint32_t id, unsigned int count);
 
 	QList<Result> topResults();
 
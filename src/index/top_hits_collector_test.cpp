@@ -61,3 +61,23 @@ TEST(TopHitsCollectorTest, NumHitsTopScorePercent2)
 	ASSERT_EQ(1, results.size());
 }
 
+
+TEST(TopHitsCollectorTest, ReplayBufferedCollector)
+{
+	BufferedCollector buffer;
+	buffer.collect(1);
+	buffer.collect(2);
+	buffer.collect(2);
+	buffer.collectMany(3, 3);
+
+	TopHitsCollector collector(10);
+	collector.collect(1);
+	buffer.replay(&collector);
+
+	QList<Result> results = collector.topResults();
+	ASSERT_EQ(3, results.size());
+	ASSERT_EQ(3, results.at(0).id());
+	ASSERT_EQ(3, results.at(0).score());
+	ASSERT_EQ(2, results.at(1).score());
+	ASSERT_EQ(2, results.at(2).score());
+}
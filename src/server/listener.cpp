@@ -16,9 +16,9 @@ using namespace Acoustid::Server;
 int Listener::m_sigIntFd[2];
 int Listener::m_sigTermFd[2];
 
-Listener::Listener(const QString& path, bool mmap, QObject* parent)
+Listener::Listener(const QString& path, bool mmap, bool preload, QObject* parent)
 	: QTcpServer(parent),
-	  m_dir(new FSDirectory(path, mmap)),
+	  m_dir(new FSDirectory(path, mmap, preload)),
 	  m_index(new Index(m_dir, true)),
 	  m_metrics(new Metrics())
 {
@@ -21,11 +21,13 @@ class Listener : public QTcpServer
 	Q_OBJECT
 
 public:
-	Listener(const QString &path, bool mmap = false, QObject *parent = 0);
+	Listener(const QString &path, bool mmap = false, bool preload = false, QObject *parent = 0);
 	~Listener();
 
 	void stop();
 
+    IndexSharedPtr index() const { return m_index; }
+
     QSharedPointer<Metrics> metrics() const { return m_metrics; }
     void setMetrics(const QSharedPointer<Metrics> &metrics) { m_metrics = metrics; }
 
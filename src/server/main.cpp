@@ -7,6 +7,8 @@
 #include "qhttpserverrequest.hpp"
 #include "qhttpserverresponse.hpp"
 #include "util/options.h"
+#include "index/block_cache.h"
+#include "index/search_result_cache.h"
 #include "listener.h"
 #include "metrics.h"
 #include "http.h"
@@ -46,6 +48,23 @@ int main(int argc, char **argv)
 		.setDefaultValue("6081");
 	parser.addOption("mmap", 'm')
 		.setHelp("use mmap to read index files");
+	parser.addOption("preload")
+		.setHelp("load index files into memory, backed by huge pages if possible");
+	parser.addOption("block-cache-size")
+		.setArgument()
+		.setHelp("size of the decoded block cache in MB, 0 to disable (default: 64)")
+		.setMetaVar("MB")
+		.setDefaultValue(QString::number(MAX_BLOCK_CACHE_SIZE / 1024 / 1024));
+	parser.addOption("result-cache-size")
+		.setArgument()
+		.setHelp("number of cached search results, 0 to disable (default: 0)")
+		.setMetaVar("N")
+		.setDefaultValue("0");
+	parser.addOption("result-cache-ttl")
+		.setArgument()
+		.setHelp("seconds the cached search results are valid for (default: 60)")
+		.setMetaVar("SECONDS")
+		.setDefaultValue("60");
 	parser.addOption("threads", 't')
 		.setArgument()
 		.setHelp("use specific number of threads")
@@ -68,12 +87,16 @@ int main(int argc, char **argv)
 		QThreadPool::globalInstance()->setMaxThreadCount(numThreads);
 	}
 
+	BlockCache::instance()->setMaxSize(size_t(opts->option("block-cache-size").toInt()) * 1024 * 1024);
+
 	auto metrics = QSharedPointer<Metrics>(new Metrics());
 
 	Listener::setupSignalHandlers();
 
-	Listener listener(path, opts->contains("mmap"));
+	Listener listener(path, opts->contains("mmap"), opts->contains("preload"));
 	listener.setMetrics(metrics);
+	listener.index()->resultCache()->setMaxSize(opts->option("result-cache-size").toInt());
+	listener.index()->resultCache()->setTtl(opts->option("result-cache-ttl").toInt());
 	listener.listen(QHostAddress(address), port);
 	qDebug() << "Simple server listening on" << address << "port" << port;
 
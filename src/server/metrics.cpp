@@ -1,11 +1,41 @@
 // Copyright (C) 2019  Lukas Lalinsky
 // Distributed under the MIT license, see the LICENSE file for details.
 
+#include "index/block_cache.h"
 #include "metrics.h"
 
 using namespace Acoustid;
 using namespace Acoustid::Server;
 
+void Histogram::observe(uint64_t value)
+{
+	uint64_t bound = 1;
+	for (int i = 0; i < kBucketCount; i++) {
+		if (value <= bound) {
+			m_buckets[i]++;
+			break;
+		}
+		bound *= 4;
+	}
+	m_count++;
+	m_sum += value;
+}
+
+void Histogram::write(const QString &name, QStringList *output) const
+{
+	output->append(QString("# TYPE %1 histogram").arg(name));
+	uint64_t count = 0;
+	uint64_t bound = 1;
+	for (int i = 0; i < kBucketCount; i++) {
+		count += m_buckets[i];
+		output->append(QString("%1_bucket{le=\"%2\"} %3").arg(name).arg(bound).arg(count));
+		bound *= 4;
+	}
+	output->append(QString("%1_bucket{le=\"+Inf\"} %2").arg(name).arg(m_count));
+	output->append(QString("%1_sum %2").arg(name).arg(m_sum));
+	output->append(QString("%1_count %2").arg(name).arg(m_count));
+}
+
 Metrics::Metrics()
 {
 }
@@ -34,6 +64,25 @@ void Metrics::onSearchRequest(int resultCount) {
 	}
 }
 
+void Metrics::onSearchResultCache(bool hit) {
+	QWriteLocker locker(&m_lock);
+	if (hit) {
+		m_searchCacheHitCount += 1;
+	} else {
+		m_searchCacheMissCount += 1;
+	}
+}
+
+void Metrics::onSearchStats(const SearchStats &stats) {
+	QWriteLocker locker(&m_lock);
+	m_searchSegments.observe(stats.segments);
+	m_searchLookups.observe(stats.lookups);
+	m_searchBlocks.observe(stats.blocks);
+	m_searchItems.observe(stats.items);
+	m_searchHits.observe(stats.hits);
+	m_searchBytes.observe(stats.bytes);
+}
+
 void Metrics::onRequest(const QString &name, double duration) {
 	QWriteLocker locker(&m_lock);
 	m_requestCount[name] += 1;
@@ -74,5 +123,29 @@ QStringList Metrics::toStringList() {
 	output.append(QString("# TYPE aindex_search_misses_total counter"));
 	output.append(QString("aindex_search_misses_total %1").arg(m_searchMissCount));
 
+	output.append(QString("# TYPE aindex_search_cache_hits_total counter"));
+	output.append(QString("aindex_search_cache_hits_total %1").arg(m_searchCacheHitCount));
+
+	output.append(QString("# TYPE aindex_search_cache_misses_total counter"));
+	output.append(QString("aindex_search_cache_misses_total %1").arg(m_searchCacheMissCount));
+
+	m_searchSegments.write("aindex_search_segments", &output);
+	m_searchLookups.write("aindex_search_index_lookups", &output);
+	m_searchBlocks.write("aindex_search_blocks", &output);
+	m_searchItems.write("aindex_search_items", &output);
+	m_searchHits.write("aindex_search_term_hits", &output);
+	m_searchBytes.write("aindex_search_bytes", &output);
+
+	BlockCache *blockCache = BlockCache::instance();
+
+	output.append(QString("# TYPE aindex_block_cache_hits_total counter"));
+	output.append(QString("aindex_block_cache_hits_total %1").arg(blockCache->hitCount()));
+
+	output.append(QString("# TYPE aindex_block_cache_misses_total counter"));
+	output.append(QString("aindex_block_cache_misses_total %1").arg(blockCache->missCount()));
+
+	output.append(QString("# TYPE aindex_block_cache_size_bytes gauge"));
+	output.append(QString("aindex_block_cache_size_bytes %1").arg(blockCache->size()));
+
 	return output;
 }
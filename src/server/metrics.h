@@ -6,11 +6,28 @@
 
 #include <QReadWriteLock>
 #include "index/index.h"
+#include "index/search_stats.h"
 #include "store/directory.h"
 
 namespace Acoustid {
 namespace Server {
 
+// Prometheus histogram with buckets at powers of four
+class Histogram
+{
+public:
+	void observe(uint64_t value);
+	void write(const QString &name, QStringList *output) const;
+
+private:
+	static const int kBucketCount = 16;
+
+	// Number of values in (4^(i-1), 4^i], the first bucket also has the smaller ones
+	uint64_t m_buckets[kBucketCount] {};
+	uint64_t m_count { 0 };
+	uint64_t m_sum { 0 };
+};
+
 class Metrics
 {
 public:
@@ -22,6 +39,8 @@ public:
 
 	void onRequest(const QString &name, double duration);
 	void onSearchRequest(int resultCount);
+	void onSearchResultCache(bool hit);
+	void onSearchStats(const SearchStats &stats);
 
 	QStringList toStringList();
 
@@ -36,6 +55,16 @@ private:
 
 	uint64_t m_searchHitCount { 0 };
 	uint64_t m_searchMissCount { 0 };
+
+	uint64_t m_searchCacheHitCount { 0 };
+	uint64_t m_searchCacheMissCount { 0 };
+
+	Histogram m_searchSegments;
+	Histogram m_searchLookups;
+	Histogram m_searchBlocks;
+	Histogram m_searchItems;
+	Histogram m_searchHits;
+	Histogram m_searchBytes;
 };
 
 }
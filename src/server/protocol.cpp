@@ -22,6 +22,12 @@ QVector<uint32_t> parseFingerprint(const QString &input) {
     return output;
 }
 
+QString renderSearchStats(const SearchStats &stats) {
+    return QString("segments=%1 lookups=%2 blocks=%3 items=%4 hits=%5 bytes=%6")
+        .arg(stats.segments).arg(stats.lookups).arg(stats.blocks)
+        .arg(stats.items).arg(stats.hits).arg(stats.bytes);
+}
+
 QString renderResponse(const QString &response) {
     return QString("OK %1").arg(response);
 }
@@ -105,12 +111,21 @@ HandlerFunc buildHandler(QSharedPointer<Session> session, const QString &line) {
                 throw HandlerException("expected one argumemt");
             }
             auto hashes = parseFingerprint(args.at(0));
-            auto results = session->search(hashes);
+            bool truncated = false;
+            SearchStats stats;
+            auto results = session->search(hashes, &truncated, &stats);
             QStringList output;
-            output.reserve(results.size());
+            output.reserve(results.size() + 1);
             for (int i = 0; i < results.size(); i++) {
                 output.append(QString("%1:%2").arg(results[i].id()).arg(results[i].score()));
             }
+            if (truncated) {
+                // The search was stopped by timeout_ms
+                output.append("truncated");
+            }
+            if (session->getAttribute("search_stats") == "1") {
+                output.append(renderSearchStats(stats));
+            }
             return output.join(" ");
         };
     }
@@ -6,6 +6,8 @@
 #include "index/top_hits_collector.h"
 #include "index/index_reader.h"
 #include "index/index_writer.h"
+#include "index/search_result_cache.h"
+#include "metrics.h"
 
 using namespace Acoustid;
 using namespace Acoustid::Server;
@@ -59,6 +61,28 @@ QString Session::getAttribute(const QString &name) {
     if (name == "top_score_percent") {
         return QString("%1").arg(m_topScorePercent);
     }
+    if (name == "max_search_threads") {
+        return QString("%1").arg(m_maxSearchThreads);
+    }
+    if (name == "max_term_frequency") {
+        return QString("%1").arg(m_maxTermFrequency);
+    }
+    if (name == "timeout_ms") {
+        return QString("%1").arg(m_timeout);
+    }
+    if (name == "search_stats") {
+        return m_searchStats ? "1" : "0";
+    }
+    if (name == "search_strategy") {
+        return m_searchStrategy == IndexReader::TwoPhaseSearch ? "two_phase" : "exact";
+    }
+    if (name == "probe_masks") {
+        QStringList masks;
+        for (size_t i = 0; i < m_probeMasks.size(); i++) {
+            masks.append(QString::number(m_probeMasks[i]));
+        }
+        return masks.join(",");
+    }
     if (m_indexWriter.isNull()) {
         return m_index->info().attribute(name);
     }
@@ -75,6 +99,70 @@ void Session::setAttribute(const QString &name, const QString &value) {
         m_topScorePercent = value.toInt();
         return;
     }
+    if (name == "max_search_threads") {
+        bool ok = false;
+        int maxSearchThreads = value.toInt(&ok);
+        if (!ok || maxSearchThreads < 1 || maxSearchThreads > IndexReader::maxSearchThreadsLimit()) {
+            throw HandlerException(QString("max_search_threads must be between 1 and %1").arg(IndexReader::maxSearchThreadsLimit()));
+        }
+        m_maxSearchThreads = maxSearchThreads;
+        return;
+    }
+    if (name == "max_term_frequency") {
+        bool ok = false;
+        size_t maxTermFrequency = value.toUInt(&ok);
+        if (!ok) {
+            throw HandlerException("max_term_frequency must be a non-negative number");
+        }
+        m_maxTermFrequency = maxTermFrequency;
+        return;
+    }
+    if (name == "timeout_ms") {
+        bool ok = false;
+        int timeout = value.toInt(&ok);
+        if (!ok || timeout < 0) {
+            throw HandlerException("timeout_ms must be a non-negative number");
+        }
+        m_timeout = timeout;
+        return;
+    }
+    if (name == "search_stats") {
+        if (value != "0" && value != "1") {
+            throw HandlerException("search_stats must be 0 or 1");
+        }
+        m_searchStats = value == "1";
+        return;
+    }
+    if (name == "search_strategy") {
+        if (value == "exact") {
+            m_searchStrategy = IndexReader::ExactSearch;
+        } else if (value == "two_phase") {
+            m_searchStrategy = IndexReader::TwoPhaseSearch;
+        } else {
+            throw HandlerException("search_strategy must be exact or two_phase");
+        }
+        return;
+    }
+    if (name == "probe_masks") {
+        std::vector<uint32_t> probeMasks;
+        QStringList masks = value.split(',');
+        for (int i = 0; i < masks.size(); i++) {
+            if (masks.at(i).isEmpty()) {
+                continue;
+            }
+            bool ok = false;
+            uint32_t mask = masks.at(i).toUInt(&ok, 0);
+            if (!ok || !mask) {
+                throw HandlerException("probe_masks must be a comma-separated list of non-zero numbers");
+            }
+            probeMasks.push_back(mask);
+        }
+        if (probeMasks.size() > 64) {
+            throw HandlerException("probe_masks can have at most 64 masks");
+        }
+        m_probeMasks = probeMasks;
+        return;
+    }
     if (m_indexWriter.isNull()) {
         throw NotInTransactionException();
     }
@@ -89,10 +177,55 @@ void Session::insert(uint32_t id, const QVector<uint32_t> &hashes) {
     m_indexWriter->addDocument(id, hashes.data(), hashes.size());
 }
 
-QList<Result> Session::search(const QVector<uint32_t> &hashes) {
+QList<Result> Session::search(const QVector<uint32_t> &hashes, bool *truncated, SearchStats *stats) {
     QMutexLocker locker(&m_mutex);
-    TopHitsCollector collector(m_maxResults, m_topScorePercent);
+    if (truncated) {
+        *truncated = false;
+    }
+    if (stats) {
+        *stats = SearchStats();
+    }
     IndexReader reader(m_index);
+    SearchResultCache *cache = m_index->resultCache();
+    SearchSettings settings(m_maxResults, m_topScorePercent, m_maxTermFrequency, m_searchStrategy);
+    settings.probeMasks = m_probeMasks;
+    std::vector<uint32_t> terms;
+    QList<Result> results;
+    if (cache->isEnabled()) {
+        terms.assign(hashes.begin(), hashes.end());
+        std::sort(terms.begin(), terms.end());
+        bool found = cache->find(reader.info().revision(), terms, settings, &results);
+        if (m_metrics) {
+            m_metrics->onSearchResultCache(found);
+        }
+        if (found) {
+            return results;
+        }
+    }
+    TopHitsCollector collector(m_maxResults, m_topScorePercent);
+    reader.setMaxSearchThreads(m_maxSearchThreads);
+    reader.setMaxTermFrequency(m_maxTermFrequency);
+    reader.setSearchStrategy(m_searchStrategy);
+    reader.setProbeMasks(m_probeMasks);
+    reader.setTimeout(m_timeout);
+    reader.setCandidateCount(std::max(reader.candidateCount(), size_t(m_maxResults)));
     reader.search(hashes.data(), hashes.size(), &collector);
-    return collector.topResults();
+    results = collector.topResults();
+    if (stats) {
+        *stats = reader.stats();
+    }
+    if (m_metrics) {
+        m_metrics->onSearchStats(reader.stats());
+    }
+    if (reader.isTruncated()) {
+        // Partial results are not cached, the same search can finish next time.
+        if (truncated) {
+            *truncated = true;
+        }
+        return results;
+    }
+    if (cache->isEnabled()) {
+        cache->insert(reader.info().revision(), terms, settings, results);
+    }
+    return results;
 }
@@ -7,6 +7,8 @@
 #include <QMutex>
 #include <QSharedPointer>
 #include "index/top_hits_collector.h"
+#include "index/index_reader.h"
+#include "index/search_stats.h"
 
 namespace Acoustid {
 
@@ -29,7 +31,10 @@ public:
     void optimize();
     void cleanup();
     void insert(uint32_t id, const QVector<uint32_t> &hashes);
-    QList<Result> search(const QVector<uint32_t> &hashes);
+    // Truncated is set if the search was stopped by the timeout, the
+    // results are then only from the part of the index searched. Stats
+    // are zero if the results come from the cache.
+    QList<Result> search(const QVector<uint32_t> &hashes, bool *truncated = nullptr, SearchStats *stats = nullptr);
 
     QString getAttribute(const QString &name);
     void setAttribute(const QString &name, const QString &value);
@@ -41,6 +46,12 @@ private:
     QSharedPointer<Metrics> m_metrics;
 	int m_topScorePercent { 10 };
 	int m_maxResults { 500 };
+	int m_maxSearchThreads { 1 };
+	size_t m_maxTermFrequency { 0 };
+	int m_timeout { 0 };
+	bool m_searchStats { false };
+	IndexReader::SearchStrategy m_searchStrategy { IndexReader::ExactSearch };
+	std::vector<uint32_t> m_probeMasks;
 };
 
 }
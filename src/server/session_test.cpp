@@ -4,6 +4,9 @@
 #include <gtest/gtest.h>
 #include "store/ram_directory.h"
 #include "index/index.h"
+#include "index/index_reader.h"
+#include "index/search_result_cache.h"
+#include "server/errors.h"
 #include "server/metrics.h"
 #include "server/session.h"
 
@@ -31,6 +34,45 @@ TEST(SessionTest, Attributes)
     ASSERT_EQ("10", session->getAttribute("top_score_percent").toStdString());
     session->setAttribute("top_score_percent", "100");
     ASSERT_EQ("100", session->getAttribute("top_score_percent").toStdString());
+
+    ASSERT_EQ("1", session->getAttribute("max_search_threads").toStdString());
+    QString maxSearchThreads = QString::number(IndexReader::maxSearchThreadsLimit());
+    session->setAttribute("max_search_threads", maxSearchThreads);
+    ASSERT_EQ(maxSearchThreads.toStdString(), session->getAttribute("max_search_threads").toStdString());
+    ASSERT_THROW(session->setAttribute("max_search_threads", "0"), HandlerException);
+    ASSERT_THROW(session->setAttribute("max_search_threads", QString::number(IndexReader::maxSearchThreadsLimit() + 1)), HandlerException);
+    ASSERT_THROW(session->setAttribute("max_search_threads", "foo"), HandlerException);
+
+    ASSERT_EQ("0", session->getAttribute("max_term_frequency").toStdString());
+    session->setAttribute("max_term_frequency", "1000");
+    ASSERT_EQ("1000", session->getAttribute("max_term_frequency").toStdString());
+    ASSERT_THROW(session->setAttribute("max_term_frequency", "-1"), HandlerException);
+    ASSERT_THROW(session->setAttribute("max_term_frequency", "foo"), HandlerException);
+    ASSERT_EQ("1000", session->getAttribute("max_term_frequency").toStdString());
+
+    ASSERT_EQ("exact", session->getAttribute("search_strategy").toStdString());
+    session->setAttribute("search_strategy", "two_phase");
+    ASSERT_EQ("two_phase", session->getAttribute("search_strategy").toStdString());
+    ASSERT_THROW(session->setAttribute("search_strategy", "foo"), HandlerException);
+
+    ASSERT_EQ("", session->getAttribute("probe_masks").toStdString());
+    session->setAttribute("probe_masks", "1,0x10,256");
+    ASSERT_EQ("1,16,256", session->getAttribute("probe_masks").toStdString());
+    ASSERT_THROW(session->setAttribute("probe_masks", "1,foo"), HandlerException);
+    ASSERT_EQ("1,16,256", session->getAttribute("probe_masks").toStdString());
+    session->setAttribute("probe_masks", "");
+    ASSERT_EQ("", session->getAttribute("probe_masks").toStdString());
+
+    ASSERT_EQ("0", session->getAttribute("timeout_ms").toStdString());
+    session->setAttribute("timeout_ms", "250");
+    ASSERT_EQ("250", session->getAttribute("timeout_ms").toStdString());
+    ASSERT_THROW(session->setAttribute("timeout_ms", "-1"), HandlerException);
+    ASSERT_THROW(session->setAttribute("timeout_ms", "foo"), HandlerException);
+
+    ASSERT_EQ("0", session->getAttribute("search_stats").toStdString());
+    session->setAttribute("search_stats", "1");
+    ASSERT_EQ("1", session->getAttribute("search_stats").toStdString());
+    ASSERT_THROW(session->setAttribute("search_stats", "yes"), HandlerException);
 }
 
 TEST(SessionTest, InsertAndSearch)
@@ -72,3 +114,30 @@ TEST(SessionTest, InsertAndSearch)
         ASSERT_EQ(3, results[0].score());
     }
 }
+
+TEST(SessionTest, SearchResultCache)
+{
+	auto storage = QSharedPointer<RAMDirectory>::create();
+	auto index = QSharedPointer<Index>::create(storage, true);
+    auto metrics = QSharedPointer<Metrics>::create();
+    auto session = QSharedPointer<Session>::create(index, metrics);
+    index->resultCache()->setMaxSize(10);
+
+    session->begin();
+    session->insert(1, { 1, 2, 3 });
+    session->commit();
+
+    ASSERT_EQ(1, session->search({ 3, 2, 1 }).size());
+    ASSERT_EQ(1, index->resultCache()->size());
+    ASSERT_EQ(1, session->search({ 1, 2, 3 }).size());
+    ASSERT_TRUE(metrics->toStringList().contains("aindex_search_cache_hits_total 1"));
+    ASSERT_TRUE(metrics->toStringList().contains("aindex_search_cache_misses_total 1"));
+    ASSERT_TRUE(metrics->toStringList().contains("aindex_search_blocks_count 1"));
+
+    // A new revision must not return the old results
+    session->begin();
+    session->insert(2, { 1, 2, 3 });
+    session->commit();
+    ASSERT_EQ(0, index->resultCache()->size());
+    ASSERT_EQ(2, session->search({ 1, 2, 3 }).size());
+}
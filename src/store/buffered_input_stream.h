@@ -27,6 +27,7 @@ public:
 	}
 
 	uint32_t readVInt32();
+	void readBytes(uint8_t *data, size_t length);
 
 	size_t position();
 	void seek(size_t position);
@@ -75,3 +75,16 @@ TEST(BufferedInputStreamTest, ReadString)
 	ASSERT_EQ(std::string("test"), inputStream.readString().toStdString());
 }
 
+
+TEST(BufferedInputStreamTest, ReadBytes)
+{
+	uint8_t data[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	SimpleBufferedInputStream inputStream(data);
+	inputStream.setBufferSize(4);
+	uint8_t result[7];
+	inputStream.readBytes(result, 7);
+	ASSERT_EQ(1, result[0]);
+	ASSERT_EQ(4, result[3]);
+	ASSERT_EQ(7, result[6]);
+	ASSERT_EQ(8, inputStream.readByte());
+}
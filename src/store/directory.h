@@ -7,6 +7,7 @@
 #include <QString>
 #include <QStringList>
 #include "common.h"
+#include "input_file.h"
 
 namespace Acoustid {
 
@@ -23,6 +24,8 @@ public:
 	virtual OutputStream *createFile(const QString &name) = 0;
 	virtual void deleteFile(const QString &name) = 0;
 	virtual InputStream *openFile(const QString &name) = 0;
+	// Open the file for reading from multiple threads
+	virtual InputFileSharedPtr openInputFile(const QString &name) = 0;
 	virtual void renameFile(const QString &oldName, const QString &newName) = 0;
 	virtual QStringList listFiles() = 0;
 	virtual bool fileExists(const QString &name);
@@ -9,14 +9,16 @@
 #include <QMutexLocker>
 #include "common.h"
 #include "mmap_input_stream.h"
+#include "mmap_input_file.h"
+#include "fs_input_file.h"
 #include "fs_input_stream.h"
 #include "fs_output_stream.h"
 #include "fs_directory.h"
 
 using namespace Acoustid;
 
-FSDirectory::FSDirectory(const QString &path, bool mmap)
-	: m_path(path), m_mmap(mmap)
+FSDirectory::FSDirectory(const QString &path, bool mmap, bool preload)
+	: m_path(path), m_mmap(mmap), m_preload(preload)
 {
 }
 
@@ -40,21 +42,72 @@ InputStream *FSDirectory::openFile(const QString &name)
 {
 	QMutexLocker locker(&m_mutex);
 	QString path = filePath(name);
+	FSFileSharedPtr file = m_preloadedFiles.value(path);
+	if (file.isNull()) {
+		file = openFSFile(path);
+	}
+	if (file->mmapAddress()) {
+		return new MMapInputStream(file);
+	}
+	return new FSInputStream(file);
+}
+
+// Open the file, or reuse the one already open. Must be called with the mutex locked.
+FSFileSharedPtr FSDirectory::openFSFile(const QString &path)
+{
 	FSFileSharedPtr file = m_openInputFiles.value(path);
-	if (m_mmap) {
-		if (file.isNull()) {
-			MMapInputStream* input = MMapInputStream::open(path);
-			m_openInputFiles.insert(path, input->file());
-			return input;
+	if (file.isNull()) {
+		if (m_mmap) {
+			std::unique_ptr<MMapInputStream> input(MMapInputStream::open(path));
+			file = input->file();
 		}
-		return new MMapInputStream(file);
+		else {
+			std::unique_ptr<FSInputStream> input(FSInputStream::open(path));
+			file = input->file();
+		}
+		m_openInputFiles.insert(path, file);
 	}
+	return file;
+}
+
+// Read the file into memory, or reuse the copy already read. The file can
+// be large, so it's read without holding the mutex.
+FSFileSharedPtr FSDirectory::preloadFSFile(const QString &path)
+{
+	{
+		QMutexLocker locker(&m_mutex);
+		FSFileSharedPtr file = m_preloadedFiles.value(path);
+		if (!file.isNull()) {
+			return file;
+		}
+	}
+	std::unique_ptr<MMapInputFile> input(MMapInputFile::preload(path));
+	QMutexLocker locker(&m_mutex);
+	FSFileSharedPtr file = m_preloadedFiles.value(path);
 	if (file.isNull()) {
-		FSInputStream* input = FSInputStream::open(path);
-		m_openInputFiles.insert(path, input->file());
-		return input;
+		file = input->file();
+		// Don't keep a copy of a file that was deleted while it was read
+		if (QFile::exists(path)) {
+			m_preloadedFiles.insert(path, file);
+		}
 	}
-	return new FSInputStream(file);
+	return file;
+}
+
+InputFileSharedPtr FSDirectory::openInputFile(const QString &name)
+{
+	FSFileSharedPtr file;
+	if (m_preload) {
+		file = preloadFSFile(filePath(name));
+	}
+	else {
+		QMutexLocker locker(&m_mutex);
+		file = openFSFile(filePath(name));
+	}
+	if (file->mmapAddress()) {
+		return InputFileSharedPtr(new MMapInputFile(file));
+	}
+	return InputFileSharedPtr(new FSInputFile(file));
 }
 
 void FSDirectory::deleteFile(const QString &name)
@@ -62,6 +115,7 @@ void FSDirectory::deleteFile(const QString &name)
 	QMutexLocker locker(&m_mutex);
 	QString path = filePath(name);
 	m_openInputFiles.remove(path);
+	m_preloadedFiles.remove(path);
 	QFile::remove(path);
 }
 
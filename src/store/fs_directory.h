@@ -18,7 +18,11 @@ class OutputStream;
 class FSDirectory : public Directory
 {
 public:
-	FSDirectory(const QString &path, bool mmap = false);
+	// With preload, files opened by openInputFile() are read into memory
+	// and kept there until they are deleted, even if they were opened as
+	// streams before. Streams are only read once, so they are not
+	// preloaded, but they use the preloaded copy if there is one.
+	FSDirectory(const QString &path, bool mmap = false, bool preload = false);
 	virtual ~FSDirectory();
 
 	virtual void close();
@@ -26,12 +30,15 @@ public:
 	virtual OutputStream *createFile(const QString &name);
 	virtual void deleteFile(const QString &name);
 	virtual InputStream *openFile(const QString &name);
+	virtual InputFileSharedPtr openInputFile(const QString &name);
 	virtual void renameFile(const QString &oldName, const QString &newName);
 	QStringList listFiles();
 	bool fileExists(const QString &name);
 	virtual void sync(const QStringList& names);
 
 private:
+	FSFileSharedPtr openFSFile(const QString &path);
+	FSFileSharedPtr preloadFSFile(const QString &path);
 
 	void fsync(const QString& name);
 
@@ -41,8 +48,10 @@ private:
 	}
 
 	bool m_mmap;
+	bool m_preload;
 	QMutex m_mutex;
 	QHash<QString, FSFileSharedPtr> m_openInputFiles;
+	QHash<QString, FSFileSharedPtr> m_preloadedFiles;
 	QString m_path;
 };
 
@@ -0,0 +1,50 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <gtest/gtest.h>
+#include <QFile>
+#include "util/test_utils.h"
+#include "input_stream.h"
+#include "fs_output_stream.h"
+#include "fs_directory.h"
+
+using namespace Acoustid;
+
+TEST(FSDirectoryTest, PreloadFileOpenedAsStream)
+{
+	QString fileName;
+	{
+		std::unique_ptr<NamedFSOutputStream> output(NamedFSOutputStream::openTemporary());
+		fileName = output->fileName();
+		for (size_t i = 0; i < 100; i++) {
+			output->writeByte(i * 7);
+		}
+	}
+	ASSERT_TRUE(fileName.startsWith("/tmp/"));
+	QString name = fileName.mid(5);
+
+	FSDirectory dir("/tmp", false, true);
+	{
+		std::unique_ptr<InputStream> input(dir.openFile(name));
+		ASSERT_EQ(0, input->readByte());
+	}
+
+	InputFileSharedPtr file = dir.openInputFile(name);
+	ASSERT_EQ(100, file->size());
+	const uint8_t *data = file->data();
+	ASSERT_TRUE(data != nullptr);
+	for (size_t i = 0; i < 100; i++) {
+		ASSERT_EQ(uint8_t(i * 7), data[i]) << "offset " << i;
+	}
+	ASSERT_EQ(data, dir.openInputFile(name)->data());
+
+	{
+		std::unique_ptr<InputStream> input(dir.openFile(name));
+		input->seek(1);
+		ASSERT_EQ(7, input->readByte());
+	}
+
+	dir.deleteFile(name);
+	ASSERT_FALSE(dir.fileExists(name));
+	ASSERT_FALSE(QFile::exists(fileName));
+}
@@ -13,15 +13,16 @@ namespace Acoustid {
 class FSFile
 {
 public:
-	explicit FSFile(int fd, void* addr = NULL, size_t length = 0)
-		: m_fd(fd), m_addr(addr), m_length(length)
+	// The mapping can be longer than the file, if mapLength is given.
+	explicit FSFile(int fd, void* addr = NULL, size_t length = 0, size_t mapLength = 0)
+		: m_fd(fd), m_addr(addr), m_length(length), m_mapLength(mapLength ? mapLength : length)
 	{
 	}
 
 	~FSFile()
 	{
 		if (m_addr) {
-			::munmap(m_addr, m_length);
+			::munmap(m_addr, m_mapLength);
 		}
 		if (m_fd) {
 			::close(m_fd);
@@ -47,6 +48,7 @@ private:
 	int m_fd;
 	void *m_addr;
 	size_t m_length;
+	size_t m_mapLength;
 };
 
 typedef QWeakPointer<FSFile> FSFileWeakPtr;
@@ -0,0 +1,56 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <errno.h>
+#include <sys/stat.h>
+#include "fs_input_file.h"
+
+using namespace Acoustid;
+
+FSInputFile::FSInputFile(const FSFileSharedPtr &file)
+	: m_file(file), m_size(0)
+{
+	struct stat sb;
+	if (fstat(fileDescriptor(), &sb) == -1) {
+		throw IOException(QString("Couldn't get the file size (errno %1)").arg(errno));
+	}
+	m_size = sb.st_size;
+}
+
+FSInputFile::~FSInputFile()
+{
+}
+
+int FSInputFile::fileDescriptor() const
+{
+	return m_file->fileDescriptor();
+}
+
+const FSFileSharedPtr &FSInputFile::file() const
+{
+	return m_file;
+}
+
+size_t FSInputFile::size() const
+{
+	return m_size;
+}
+
+void FSInputFile::read(uint8_t *data, size_t offset, size_t length)
+{
+	while (length > 0) {
+		ssize_t result = pread(fileDescriptor(), (void *)data, length, offset);
+		if (result == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw IOException(QString("Couldn't read from a file (errno %1)").arg(errno));
+		}
+		if (result == 0) {
+			throw IOException("reading past the end of file");
+		}
+		data += result;
+		offset += result;
+		length -= result;
+	}
+}
@@ -0,0 +1,32 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_STORE_FS_INPUT_FILE_H_
+#define ACOUSTID_STORE_FS_INPUT_FILE_H_
+
+#include "fs_file.h"
+#include "input_file.h"
+
+namespace Acoustid {
+
+// File read with pread(), which doesn't use the file offset.
+class FSInputFile : public InputFile
+{
+public:
+	explicit FSInputFile(const FSFileSharedPtr &file);
+	~FSInputFile();
+
+	int fileDescriptor() const;
+	const FSFileSharedPtr &file() const;
+
+	size_t size() const;
+	void read(uint8_t *data, size_t offset, size_t length);
+
+private:
+	FSFileSharedPtr m_file;
+	size_t m_size;
+};
+
+}
+
+#endif
@@ -0,0 +1,19 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include "input_file.h"
+
+using namespace Acoustid;
+
+InputFile::~InputFile()
+{
+}
+
+void InputFile::prefetch(size_t, size_t)
+{
+}
+
+const uint8_t *InputFile::data() const
+{
+	return nullptr;
+}
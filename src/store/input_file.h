@@ -0,0 +1,37 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_STORE_INPUT_FILE_H_
+#define ACOUSTID_STORE_INPUT_FILE_H_
+
+#include <QSharedPointer>
+#include "common.h"
+
+namespace Acoustid {
+
+// Read-only file with random access. Unlike InputStream, it has no
+// position, so one instance can be used by multiple threads at once.
+class InputFile
+{
+public:
+	virtual ~InputFile();
+
+	virtual size_t size() const = 0;
+
+	// Read exactly length bytes starting at the offset, throws an
+	// IOException if the file is too short.
+	virtual void read(uint8_t *data, size_t offset, size_t length) = 0;
+
+	// Hint that the range is going to be read soon.
+	virtual void prefetch(size_t offset, size_t length);
+
+	// Contents of the whole file if it's in memory, NULL otherwise. The
+	// data is valid as long as this object exists.
+	virtual const uint8_t *data() const;
+};
+
+typedef QSharedPointer<InputFile> InputFileSharedPtr;
+
+}
+
+#endif
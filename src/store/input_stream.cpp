@@ -9,13 +9,18 @@ InputStream::~InputStream()
 {
 }
 
+void InputStream::readBytes(uint8_t *data, size_t length)
+{
+	for (size_t i = 0; i < length; i++) {
+		data[i] = readByte();
+	}
+}
+
 QString InputStream::readString()
 {
 	size_t size = readVInt32();
 	std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
-	for (size_t i = 0; i < size; i++) {
-		data[i] = readByte();
-	}
+	readBytes(data.get(), size);
 	return QString::fromUtf8(reinterpret_cast<const char *>(data.get()), size);
 }
 
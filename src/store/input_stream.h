@@ -39,6 +39,8 @@ public:
 		return i;
 	}
 
+	virtual void readBytes(uint8_t *data, size_t length);
+
 	virtual QString readString();
 
 	virtual size_t position() = 0;
@@ -82,3 +82,15 @@ TEST(InputStreamTest, ReadString)
 	ASSERT_EQ(std::string("test"), inputStream.readString().toStdString());
 }
 
+
+TEST(InputStreamTest, ReadBytes)
+{
+	uint8_t data[] = { 1, 2, 3, 4 };
+	SimpleInputStream inputStream(data);
+	uint8_t result[3];
+	inputStream.readBytes(result, 3);
+	ASSERT_EQ(1, result[0]);
+	ASSERT_EQ(2, result[1]);
+	ASSERT_EQ(3, result[2]);
+	ASSERT_EQ(4, inputStream.readByte());
+}
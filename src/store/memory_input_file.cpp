@@ -0,0 +1,46 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <string.h>
+#include <algorithm>
+#include "memory_input_file.h"
+
+using namespace Acoustid;
+
+MemoryInputFile::MemoryInputFile(const uint8_t *addr, size_t length)
+	: m_addr(addr), m_length(length)
+{
+}
+
+MemoryInputFile::~MemoryInputFile()
+{
+}
+
+size_t MemoryInputFile::size() const
+{
+	return m_length;
+}
+
+void MemoryInputFile::read(uint8_t *data, size_t offset, size_t length)
+{
+	if (offset > m_length || length > m_length - offset) {
+		throw IOException("reading past the end of data");
+	}
+	memcpy(data, m_addr + offset, length);
+}
+
+const uint8_t *MemoryInputFile::data() const
+{
+	return m_addr;
+}
+
+void MemoryInputFile::prefetch(size_t offset, size_t length)
+{
+	if (offset >= m_length) {
+		return;
+	}
+	const uint8_t *end = m_addr + offset + std::min(length, m_length - offset);
+	for (const uint8_t *ptr = m_addr + offset; ptr < end; ptr += 64) {
+		__builtin_prefetch(ptr);
+	}
+}
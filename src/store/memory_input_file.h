@@ -0,0 +1,29 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_STORE_MEMORY_INPUT_FILE_H_
+#define ACOUSTID_STORE_MEMORY_INPUT_FILE_H_
+
+#include "input_file.h"
+
+namespace Acoustid {
+
+class MemoryInputFile : public InputFile
+{
+public:
+	MemoryInputFile(const uint8_t *addr, size_t length);
+	~MemoryInputFile();
+
+	size_t size() const;
+	void read(uint8_t *data, size_t offset, size_t length);
+	void prefetch(size_t offset, size_t length);
+	const uint8_t *data() const;
+
+private:
+	const uint8_t *m_addr;
+	size_t m_length;
+};
+
+}
+
+#endif
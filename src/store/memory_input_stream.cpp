@@ -37,6 +37,15 @@ uint8_t MemoryInputStream::readByte()
 	return m_addr[m_position++];
 }
 
+void MemoryInputStream::readBytes(uint8_t *data, size_t length)
+{
+	if (m_length - m_position < length) {
+		throw IOException("reading past the end of data");
+	}
+	memcpy(data, &m_addr[m_position], length);
+	m_position += length;
+}
+
 uint32_t MemoryInputStream::readVInt32()
 {
 	if (m_length - m_position >= kMaxVInt32Bytes) {
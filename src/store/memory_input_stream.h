@@ -19,6 +19,7 @@ public:
 
 	uint8_t readByte();
 	uint32_t readVInt32();
+	void readBytes(uint8_t *data, size_t length);
 
 private:
 	const uint8_t *m_addr;
@@ -0,0 +1,79 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <algorithm>
+#include <QString>
+#include <QFile>
+#include <errno.h>
+#include <sys/mman.h>
+#include "common.h"
+#include "mmap_input_file.h"
+
+using namespace Acoustid;
+
+// Transparent huge pages are only used for aligned ranges of this size
+static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+MMapInputFile::MMapInputFile(const FSFileSharedPtr &file)
+	: MemoryInputFile(file->mmapAddress(), file->mmapLength()), m_file(file)
+{
+}
+
+const FSFileSharedPtr &MMapInputFile::file() const
+{
+	return m_file;
+}
+
+MMapInputFile *MMapInputFile::preload(const QString &fileName)
+{
+	QByteArray encodedFileName = QFile::encodeName(fileName);
+	int fd = ::open(encodedFileName.data(), O_RDONLY);
+	if (fd == -1) {
+		throw IOException(QString("Couldn't open the file '%1' for reading (errno %2)").arg(fileName).arg(errno));
+	}
+	struct stat sb;
+	if (fstat(fd, &sb) == -1) {
+		int error = errno;
+		::close(fd);
+		throw IOException(QString("Couldn't get the size of the file '%1' (errno %2)").arg(fileName).arg(error));
+	}
+	size_t length = sb.st_size;
+	// Smaller files would waste most of the huge page
+	bool hugePages = length >= kHugePageSize;
+	size_t mapLength = hugePages ? (length + kHugePageSize - 1) & ~(kHugePageSize - 1) : std::max(length, size_t(1));
+	size_t reservedLength = hugePages ? mapLength + kHugePageSize : mapLength;
+	void *reserved = ::mmap(NULL, reservedLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reserved == MAP_FAILED) {
+		::close(fd);
+		throw IOException(QString("Couldn't allocate memory for the file '%1' (errno %2)").arg(fileName).arg(errno));
+	}
+	uint8_t *addr = static_cast<uint8_t *>(reserved);
+	if (hugePages) {
+		// Trim the mapping to start at a huge page boundary
+		uintptr_t start = reinterpret_cast<uintptr_t>(reserved);
+		addr = reinterpret_cast<uint8_t *>((start + kHugePageSize - 1) & ~uintptr_t(kHugePageSize - 1));
+		uint8_t *end = static_cast<uint8_t *>(reserved) + reservedLength;
+		if (addr > reserved) {
+			::munmap(reserved, addr - static_cast<uint8_t *>(reserved));
+		}
+		if (end > addr + mapLength) {
+			::munmap(addr + mapLength, end - (addr + mapLength));
+		}
+		::madvise(addr, mapLength, MADV_HUGEPAGE);
+	}
+	FSFileSharedPtr file(new FSFile(fd, addr, length, mapLength));
+	// Reading the data populates the whole mapping
+	size_t offset = 0;
+	while (offset < length) {
+		ssize_t size = ::pread(fd, addr + offset, length - offset, offset);
+		if (size == -1 && errno == EINTR) {
+			continue;
+		}
+		if (size <= 0) {
+			throw IOException(QString("Couldn't read the file '%1' (errno %2)").arg(fileName).arg(size ? errno : 0));
+		}
+		offset += size;
+	}
+	::mprotect(addr, mapLength, PROT_READ);
+	return new MMapInputFile(file);
+}
@@ -0,0 +1,30 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_STORE_MMAP_INPUT_FILE_H_
+#define ACOUSTID_STORE_MMAP_INPUT_FILE_H_
+
+#include "fs_file.h"
+#include "memory_input_file.h"
+
+namespace Acoustid {
+
+class MMapInputFile : public MemoryInputFile
+{
+public:
+	explicit MMapInputFile(const FSFileSharedPtr &file);
+
+	const FSFileSharedPtr &file() const;
+
+	// Read the whole file into anonymous memory, backed by transparent
+	// huge pages if the file is large enough. Unlike with a shared
+	// mapping, no page faults happen when the data is used later.
+	static MMapInputFile *preload(const QString &fileName);
+
+private:
+	FSFileSharedPtr m_file;
+};
+
+}
+
+#endif
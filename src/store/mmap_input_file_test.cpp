@@ -0,0 +1,45 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <gtest/gtest.h>
+#include <QFile>
+#include "util/test_utils.h"
+#include "fs_output_stream.h"
+#include "mmap_input_file.h"
+
+using namespace Acoustid;
+
+static void testPreload(size_t length)
+{
+	QString fileName;
+	{
+		std::unique_ptr<NamedFSOutputStream> output(NamedFSOutputStream::openTemporary());
+		fileName = output->fileName();
+		for (size_t i = 0; i < length; i++) {
+			output->writeByte(i * 7);
+		}
+	}
+
+	{
+		std::unique_ptr<MMapInputFile> file(MMapInputFile::preload(fileName));
+		ASSERT_EQ(length, file->size());
+		const uint8_t *data = file->data();
+		ASSERT_TRUE(data != nullptr);
+		for (size_t i = 0; i < length; i++) {
+			ASSERT_EQ(uint8_t(i * 7), data[i]) << "offset " << i;
+		}
+		if (length >= 2 * 1024 * 1024) {
+			// Aligned, so that huge pages can be used
+			ASSERT_EQ(0, reinterpret_cast<uintptr_t>(data) % (2 * 1024 * 1024));
+		}
+	}
+
+	QFile::remove(fileName);
+}
+
+TEST(MMapInputFileTest, Preload)
+{
+	testPreload(0);
+	testPreload(1000);
+	testPreload(3 * 1024 * 1024 + 5);
+}
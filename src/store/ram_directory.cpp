@@ -2,6 +2,7 @@
 // Distributed under the MIT license, see the LICENSE file for details.
 
 #include "memory_input_stream.h"
+#include "memory_input_file.h"
 #include "ram_output_stream.h"
 #include "ram_directory.h"
 
@@ -52,6 +53,15 @@ InputStream *RAMDirectory::openFile(const QString &name)
 	return new MemoryInputStream(reinterpret_cast<const uint8_t *>(data->constData()), data->size());
 }
 
+InputFileSharedPtr RAMDirectory::openInputFile(const QString &name)
+{
+	QByteArray *data = m_data.value(name);
+	if (!data) {
+		throw IOException("file does not exist");
+	}
+	return InputFileSharedPtr(new MemoryInputFile(reinterpret_cast<const uint8_t *>(data->constData()), data->size()));
+}
+
 OutputStream *RAMDirectory::createFile(const QString &name)
 {
 	QByteArray *data = new QByteArray();
@@ -27,6 +27,7 @@ public:
 	virtual OutputStream *createFile(const QString &name);
 	virtual void deleteFile(const QString &name);
 	virtual InputStream *openFile(const QString &name);
+	virtual InputFileSharedPtr openInputFile(const QString &name);
 	virtual void renameFile(const QString &oldName, const QString &newName);
 	QStringList listFiles();
 	bool fileExists(const QString &name);
@@ -47,6 +47,26 @@ TEST(RAMDirectoryTest, OpenFile)
 	ASSERT_EQ(0, input->readByte());
 }
 
+TEST(RAMDirectoryTest, OpenInputFile)
+{
+	RAMDirectory dir;
+	std::unique_ptr<OutputStream> output(dir.createFile("test.txt"));
+	output->writeByte('a');
+	output->writeByte('b');
+	output->writeByte('c');
+	output->writeByte(0);
+	output.reset();
+	InputFileSharedPtr input = dir.openInputFile("test.txt");
+	ASSERT_EQ(4, input->size());
+	uint8_t data[2];
+	input->read(data, 1, 2);
+	ASSERT_EQ('b', data[0]);
+	ASSERT_EQ('c', data[1]);
+	input->read(data, 0, 1);
+	ASSERT_EQ('a', data[0]);
+	ASSERT_THROW(input->read(data, 3, 2), IOException);
+}
+
 TEST(RAMDirectoryTest, OpenNonExistantFile)
 {
 	RAMDirectory dir;
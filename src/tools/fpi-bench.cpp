@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <QSet>
+#include "index/index.h"
+#include "index/index_reader.h"
+#include "index/top_hits_collector.h"
+#include "store/fs_directory.h"
+#include "util/options.h"
+#include "util/timer.h"
+
+using namespace Acoustid;
+
+// Compares the two-phase search strategy with the exact search, using
+// fingerprints in the fpi-import format as queries.
+int main(int argc, char **argv)
+{
+	OptionParser parser("%prog [options] < FINGERPRINTS");
+	parser.addOption("directory", 'd')
+		.setArgument()
+		.setHelp("index directory")
+		.setMetaVar("DIR");
+	parser.addOption("max-results", 'n')
+		.setArgument()
+		.setHelp("number of results to compare (default: 10)")
+		.setMetaVar("N");
+	parser.addOption("sample-bits", 's')
+		.setArgument()
+		.setHelp("search 1 in 2^BITS terms in the first phase (default: 2)")
+		.setMetaVar("BITS");
+	parser.addOption("candidates", 'c')
+		.setArgument()
+		.setHelp("number of candidates after the first phase (default: 100)")
+		.setMetaVar("N");
+	Options *opts = parser.parse(argc, argv);
+
+	QString path = ".";
+	if (opts->contains("directory")) {
+		path = opts->option("directory");
+	}
+	int maxResults = opts->contains("max-results") ? opts->option("max-results").toInt() : 10;
+
+	DirectorySharedPtr dir(new FSDirectory(path));
+	IndexSharedPtr index;
+	try {
+		index = IndexSharedPtr(new Index(dir));
+	}
+	catch (IOException &ex) {
+		qCritical() << "ERROR:" << ex.what();
+		return 1;
+	}
+
+	IndexReader exactReader(index);
+	IndexReader approxReader(index);
+	approxReader.setSearchStrategy(IndexReader::TwoPhaseSearch);
+	if (opts->contains("sample-bits")) {
+		approxReader.setSampleBits(opts->option("sample-bits").toInt());
+	}
+	if (opts->contains("candidates")) {
+		approxReader.setCandidateCount(opts->option("candidates").toInt());
+	}
+
+	const size_t lineSize = 1024 * 1024;
+	static char line[lineSize];
+	std::vector<uint32_t> fp;
+
+	size_t queryCount = 0, expectedCount = 0, foundCount = 0, topFoundCount = 0;
+	double exactTime = 0.0, approxTime = 0.0;
+	while (fgets(line, lineSize, stdin) != NULL) {
+		char *ptr = line;
+		strtol(ptr, &ptr, 10);
+		if (*ptr++ != '|' || *ptr != '{') {
+			qWarning() << "Invalid line";
+			continue;
+		}
+		fp.clear();
+		while (*ptr != '}' && *ptr != 0) {
+			ptr++;
+			fp.push_back(strtol(ptr, &ptr, 10));
+		}
+
+		Timer timer;
+		timer.start();
+		TopHitsCollector exactCollector(maxResults);
+		exactReader.search(fp.data(), fp.size(), &exactCollector);
+		QList<Result> expected = exactCollector.topResults();
+		exactTime += timer.restart();
+		TopHitsCollector approxCollector(maxResults);
+		approxReader.search(fp.data(), fp.size(), &approxCollector);
+		QList<Result> results = approxCollector.topResults();
+		approxTime += timer.elapsed();
+
+		QSet<uint32_t> ids;
+		for (int i = 0; i < results.size(); i++) {
+			ids.insert(results[i].id());
+		}
+		for (int i = 0; i < expected.size(); i++) {
+			if (ids.contains(expected[i].id())) {
+				foundCount++;
+			}
+		}
+		if (expected.isEmpty() || (!results.isEmpty() && results[0].id() == expected[0].id())) {
+			topFoundCount++;
+		}
+		expectedCount += expected.size();
+		queryCount++;
+	}
+
+	if (!queryCount) {
+		qCritical() << "ERROR: no queries";
+		return 1;
+	}
+	printf("Queries: %zu\n", queryCount);
+	printf("Recall@%d: %.4f\n", maxResults, expectedCount ? double(foundCount) / expectedCount : 1.0);
+	printf("Top result recall: %.4f\n", double(topFoundCount) / queryCount);
+	printf("Exact search: %.3f ms/query\n", exactTime / queryCount);
+	printf("Two-phase search: %.3f ms/query\n", approxTime / queryCount);
+	printf("Speedup: %.2fx\n", approxTime > 0 ? exactTime / approxTime : 0.0);
+	return 0;
+}
@@ -0,0 +1,94 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include "bitpack.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <emmintrin.h>
+#define ACOUSTID_BITPACK_SIMD
+#endif
+
+namespace Acoustid {
+
+static inline uint32_t bitMask(int width)
+{
+	return width == 32 ? UINT32_MAX : (1u << width) - 1;
+}
+
+void packBits128(const uint32_t *values, int width, uint32_t *output)
+{
+	memset(output, 0, 4 * width * sizeof(uint32_t));
+	for (size_t i = 0; i < 32; i++) {
+		size_t bit = i * width, word = bit / 32, shift = bit % 32;
+		for (size_t lane = 0; lane < 4; lane++) {
+			uint32_t value = values[4 * i + lane];
+			output[4 * word + lane] |= value << shift;
+			if (shift + width > 32) {
+				output[4 * (word + 1) + lane] |= value >> (32 - shift);
+			}
+		}
+	}
+}
+
+uint32_t unpackDeltas128Scalar(const uint32_t *input, int width, uint32_t base, uint32_t *values)
+{
+	uint32_t mask = bitMask(width);
+	for (size_t i = 0; i < 32; i++) {
+		size_t bit = i * width, word = bit / 32, shift = bit % 32;
+		for (size_t lane = 0; lane < 4; lane++) {
+			uint32_t delta = 0;
+			if (width) {
+				delta = input[4 * word + lane] >> shift;
+				if (shift + width > 32) {
+					delta |= input[4 * (word + 1) + lane] << (32 - shift);
+				}
+			}
+			base += delta & mask;
+			values[4 * i + lane] = base;
+		}
+	}
+	return base;
+}
+
+#ifdef ACOUSTID_BITPACK_SIMD
+
+// Unpacks one value from each lane, then adds up the four deltas with two
+// shifted additions.
+__attribute__((target("sse2")))
+uint32_t unpackDeltas128SSE2(const uint32_t *input, int width, uint32_t base, uint32_t *values)
+{
+	const __m128i *words = reinterpret_cast<const __m128i *>(input);
+	__m128i *output = reinterpret_cast<__m128i *>(values);
+	__m128i mask = _mm_set1_epi32(bitMask(width));
+	__m128i sum = _mm_set1_epi32(base);
+	for (size_t i = 0; i < 32; i++) {
+		__m128i delta = _mm_setzero_si128();
+		if (width) {
+			size_t bit = i * width, word = bit / 32, shift = bit % 32;
+			delta = _mm_srl_epi32(_mm_loadu_si128(words + word), _mm_cvtsi32_si128(shift));
+			if (shift + width > 32) {
+				delta = _mm_or_si128(delta, _mm_sll_epi32(_mm_loadu_si128(words + word + 1), _mm_cvtsi32_si128(32 - shift)));
+			}
+			delta = _mm_and_si128(delta, mask);
+		}
+		delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 4));
+		delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+		sum = _mm_add_epi32(sum, delta);
+		_mm_storeu_si128(output + i, sum);
+		sum = _mm_shuffle_epi32(sum, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	return values[127];
+}
+
+#endif
+
+uint32_t unpackDeltas128(const uint32_t *input, int width, uint32_t base, uint32_t *values)
+{
+#ifdef ACOUSTID_BITPACK_SIMD
+	return unpackDeltas128SSE2(input, width, base, values);
+#else
+	return unpackDeltas128Scalar(input, width, base, values);
+#endif
+}
+
+}
@@ -0,0 +1,34 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_UTIL_BITPACK_H_
+#define ACOUSTID_UTIL_BITPACK_H_
+
+#include "common.h"
+
+namespace Acoustid {
+
+// Values are bit-packed in frames of 128, all with the same number of
+// bits. A frame with width bits per value takes 4 * width words. The
+// values are interleaved in four lanes, value i is in lane i % 4, so
+// that four consecutive values can be unpacked at once.
+
+// Number of bits needed to store the value
+inline int bitWidth(uint32_t value)
+{
+	return value ? 32 - __builtin_clz(value) : 0;
+}
+
+// Pack a frame of values, which must fit into width bits.
+void packBits128(const uint32_t *values, int width, uint32_t *output);
+
+// Unpack a frame of deltas and add them up, starting from base. Returns
+// the last value. Uses SIMD instructions if the CPU supports them.
+uint32_t unpackDeltas128(const uint32_t *input, int width, uint32_t base, uint32_t *values);
+
+// Portable version of unpackDeltas128()
+uint32_t unpackDeltas128Scalar(const uint32_t *input, int width, uint32_t base, uint32_t *values);
+
+}
+
+#endif
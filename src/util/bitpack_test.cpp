@@ -0,0 +1,40 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <gtest/gtest.h>
+#include "util/test_utils.h"
+#include "bitpack.h"
+
+using namespace Acoustid;
+
+TEST(BitPackTest, BitWidth)
+{
+	ASSERT_EQ(0, bitWidth(0));
+	ASSERT_EQ(1, bitWidth(1));
+	ASSERT_EQ(2, bitWidth(2));
+	ASSERT_EQ(2, bitWidth(3));
+	ASSERT_EQ(8, bitWidth(255));
+	ASSERT_EQ(9, bitWidth(256));
+	ASSERT_EQ(32, bitWidth(UINT32_MAX));
+}
+
+TEST(BitPackTest, PackUnpackDeltas)
+{
+	uint32_t seed = 1;
+	for (int width = 0; width <= 32; width++) {
+		uint32_t deltas[128], expected[128], values[128], packed[4 * 32 + 4];
+		uint32_t mask = width == 32 ? UINT32_MAX : (1u << width) - 1;
+		uint32_t base = 1000 * width;
+		for (size_t i = 0; i < 128; i++) {
+			seed = seed * 1103515245 + 12345;
+			deltas[i] = i == 77 ? mask : seed & mask;
+			base += deltas[i];
+			expected[i] = base;
+		}
+		packBits128(deltas, width, packed);
+		ASSERT_EQ(base, unpackDeltas128(packed, width, 1000 * width, values)) << "width " << width;
+		ASSERT_INTARRAY_EQ(expected, values, 128);
+		ASSERT_EQ(base, unpackDeltas128Scalar(packed, width, 1000 * width, values)) << "width " << width;
+		ASSERT_INTARRAY_EQ(expected, values, 128);
+	}
+}
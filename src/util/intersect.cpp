@@ -0,0 +1,127 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include "intersect.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ACOUSTID_INTERSECT_SIMD
+#endif
+
+namespace Acoustid {
+
+// Merge the arrays starting at keys[i] and terms[t], with n matches found so far
+static inline size_t intersectSortedFrom(const uint32_t *keys, size_t keyCount, const uint32_t *terms, size_t termCount,
+	uint32_t *keyMatches, uint32_t *termMatches, size_t i, size_t t, size_t n)
+{
+	while (i < keyCount && t < termCount) {
+		if (keys[i] < terms[t]) {
+			i++;
+		}
+		else if (keys[i] > terms[t]) {
+			t++;
+		}
+		else {
+			keyMatches[n] = i;
+			termMatches[n] = t;
+			n++;
+			i++;
+		}
+	}
+	return n;
+}
+
+size_t intersectSortedScalar(const uint32_t *keys, size_t keyCount, const uint32_t *terms, size_t termCount,
+	uint32_t *keyMatches, uint32_t *termMatches)
+{
+	return intersectSortedFrom(keys, keyCount, terms, termCount, keyMatches, termMatches, 0, 0, 0);
+}
+
+#ifdef ACOUSTID_INTERSECT_SIMD
+
+// The SIMD versions compare one term with a vector of keys at a time. The
+// keys not greater than the term are consumed, and if any key is greater,
+// the next term follows. A block usually has only a few terms, so
+// most of the keys are skipped a whole vector at a time without a branch
+// per key. There are no unsigned comparisons, so the sign bit is flipped.
+
+__attribute__((target("sse2")))
+size_t intersectSortedSSE2(const uint32_t *keys, size_t keyCount, const uint32_t *terms, size_t termCount,
+	uint32_t *keyMatches, uint32_t *termMatches)
+{
+	const __m128i signBit = _mm_set1_epi32(INT32_MIN);
+	size_t i = 0, t = 0, n = 0;
+	while (i + 4 <= keyCount && t < termCount) {
+		__m128i k = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i)), signBit);
+		__m128i v = _mm_set1_epi32(terms[t] ^ 0x80000000u);
+		__m128i eq = _mm_cmpeq_epi32(k, v);
+		unsigned int eqMask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+		unsigned int gtMask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v)));
+		while (eqMask) {
+			keyMatches[n] = i + __builtin_ctz(eqMask);
+			termMatches[n] = t;
+			n++;
+			eqMask &= eqMask - 1;
+		}
+		if (!gtMask) {
+			i += 4;
+		}
+		else {
+			i += __builtin_ctz(gtMask);
+			t++;
+		}
+	}
+	return intersectSortedFrom(keys, keyCount, terms, termCount, keyMatches, termMatches, i, t, n);
+}
+
+__attribute__((target("avx2")))
+size_t intersectSortedAVX2(const uint32_t *keys, size_t keyCount, const uint32_t *terms, size_t termCount,
+	uint32_t *keyMatches, uint32_t *termMatches)
+{
+	const __m256i signBit = _mm256_set1_epi32(INT32_MIN);
+	size_t i = 0, t = 0, n = 0;
+	while (i + 8 <= keyCount && t < termCount) {
+		__m256i k = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i)), signBit);
+		__m256i v = _mm256_set1_epi32(terms[t] ^ 0x80000000u);
+		__m256i eq = _mm256_cmpeq_epi32(k, v);
+		unsigned int eqMask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+		unsigned int gtMask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v)));
+		while (eqMask) {
+			keyMatches[n] = i + __builtin_ctz(eqMask);
+			termMatches[n] = t;
+			n++;
+			eqMask &= eqMask - 1;
+		}
+		if (!gtMask) {
+			i += 8;
+		}
+		else {
+			i += __builtin_ctz(gtMask);
+			t++;
+		}
+	}
+	return intersectSortedFrom(keys, keyCount, terms, termCount, keyMatches, termMatches, i, t, n);
+}
+
+static bool hasAVX2()
+{
+	static const bool result = __builtin_cpu_supports("avx2");
+	return result;
+}
+
+#endif
+
+size_t intersectSorted(const uint32_t *keys, size_t keyCount, const uint32_t *terms, size_t termCount,
+	uint32_t *keyMatches, uint32_t *termMatches)
+{
+#ifdef ACOUSTID_INTERSECT_SIMD
+	if (hasAVX2()) {
+		return intersectSortedAVX2(keys, keyCount, terms, termCount, keyMatches, termMatches);
+	}
+	return intersectSortedSSE2(keys, keyCount, terms, termCount, keyMatches, termMatches);
+#else
+	return intersectSortedScalar(keys, keyCount, terms, termCount, keyMatches, termMatches);
+#endif
+}
+
+}
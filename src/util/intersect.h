@@ -0,0 +1,25 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#ifndef ACOUSTID_UTIL_INTERSECT_H_
+#define ACOUSTID_UTIL_INTERSECT_H_
+
+#include "common.h"
+
+namespace Acoustid {
+
+// Find the keys that are equal to one of the terms, both arrays must be
+// sorted and can have duplicates. For each matching key, its position and
+// the position of the first term equal to it are stored, in the order of
+// the keys. Returns the number of matches, which is at most keyCount.
+// Uses SIMD instructions if the CPU supports them.
+size_t intersectSorted(const uint32_t *keys, size_t keyCount, const uint32_t *terms, size_t termCount,
+	uint32_t *keyMatches, uint32_t *termMatches);
+
+// Portable version of intersectSorted()
+size_t intersectSortedScalar(const uint32_t *keys, size_t keyCount, const uint32_t *terms, size_t termCount,
+	uint32_t *keyMatches, uint32_t *termMatches);
+
+}
+
+#endif
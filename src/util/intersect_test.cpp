@@ -0,0 +1,53 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <algorithm>
+#include <vector>
+#include <gtest/gtest.h>
+#include "util/test_utils.h"
+#include "intersect.h"
+
+using namespace Acoustid;
+
+TEST(IntersectTest, IntersectSorted)
+{
+	uint32_t keys[] = { 1, 3, 3, 3, 5, 8, 9, 9, 10, 12, 0x80000000u, UINT32_MAX };
+	uint32_t terms[] = { 0, 3, 3, 9, 11, 12, 0x80000000u, UINT32_MAX };
+	uint32_t expectedKeyMatches[] = { 1, 2, 3, 6, 7, 9, 10, 11 };
+	uint32_t expectedTermMatches[] = { 1, 1, 1, 3, 3, 5, 6, 7 };
+	uint32_t keyMatches[12], termMatches[12];
+	ASSERT_EQ(8, intersectSorted(keys, 12, terms, 8, keyMatches, termMatches));
+	ASSERT_INTARRAY_EQ(expectedKeyMatches, keyMatches, 8);
+	ASSERT_INTARRAY_EQ(expectedTermMatches, termMatches, 8);
+	ASSERT_EQ(8, intersectSortedScalar(keys, 12, terms, 8, keyMatches, termMatches));
+	ASSERT_INTARRAY_EQ(expectedKeyMatches, keyMatches, 8);
+	ASSERT_INTARRAY_EQ(expectedTermMatches, termMatches, 8);
+	ASSERT_EQ(0, intersectSorted(keys, 12, terms, 0, keyMatches, termMatches));
+	ASSERT_EQ(0, intersectSorted(keys, 0, terms, 8, keyMatches, termMatches));
+}
+
+TEST(IntersectTest, IntersectSortedRandom)
+{
+	uint32_t seed = 1;
+	for (size_t n = 0; n < 200; n++) {
+		std::vector<uint32_t> keys, terms;
+		size_t keyCount = n % 70, termCount = n % 13;
+		uint32_t range = n % 3 ? 100 : UINT32_MAX;
+		for (size_t i = 0; i < keyCount + termCount; i++) {
+			seed = seed * 1103515245 + 12345;
+			(i < keyCount ? keys : terms).push_back(seed % range);
+		}
+		std::sort(keys.begin(), keys.end());
+		std::sort(terms.begin(), terms.end());
+		std::vector<uint32_t> keyMatches(keyCount), termMatches(keyCount);
+		std::vector<uint32_t> scalarKeyMatches(keyCount), scalarTermMatches(keyCount);
+		size_t count = intersectSorted(keys.data(), keyCount, terms.data(), termCount, keyMatches.data(), termMatches.data());
+		ASSERT_EQ(intersectSortedScalar(keys.data(), keyCount, terms.data(), termCount, scalarKeyMatches.data(), scalarTermMatches.data()), count);
+		for (size_t i = 0; i < count; i++) {
+			ASSERT_EQ(scalarKeyMatches[i], keyMatches[i]);
+			ASSERT_EQ(scalarTermMatches[i], termMatches[i]);
+			ASSERT_EQ(keys[keyMatches[i]], terms[termMatches[i]]);
+			ASSERT_TRUE(termMatches[i] == 0 || terms[termMatches[i] - 1] != terms[termMatches[i]]);
+		}
+	}
+}
@@ -0,0 +1,299 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <algorithm>
+#include "vint.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ACOUSTID_VINT_SSSE3
+#endif
+
+namespace Acoustid {
+
+ssize_t readVInt32ArrayFromArrayScalar(const uint8_t *buffer, size_t length, uint32_t *values, size_t count)
+{
+	const uint8_t *ptr = buffer;
+	const uint8_t *end = buffer + length;
+	for (size_t i = 0; i < count; i++) {
+		if (ptr >= end) {
+			return -1;
+		}
+		ssize_t size = readVInt32FromArray(ptr, &values[i]);
+		if (size == -1) {
+			return -1;
+		}
+		ptr += size;
+	}
+	if (ptr > end) {
+		return -1;
+	}
+	return ptr - buffer;
+}
+
+ssize_t readStreamVByte32FromArrayScalar(const uint8_t *buffer, size_t length, uint32_t *values, size_t count)
+{
+	size_t controlSize = streamVByte32ControlSize(count);
+	if (controlSize > length) {
+		return -1;
+	}
+	const uint8_t *control = buffer;
+	const uint8_t *ptr = buffer + controlSize;
+	const uint8_t *end = buffer + length;
+	for (size_t i = 0; i < count; i++) {
+		size_t size = ((control[i / 4] >> (i % 4 * 2)) & 3) + 1;
+		if (ptr + size > end) {
+			return -1;
+		}
+		uint32_t value = 0;
+		for (size_t j = 0; j < size; j++) {
+			value |= uint32_t(ptr[j]) << (j * 8);
+		}
+		values[i] = value;
+		ptr += size;
+	}
+	return ptr - buffer;
+}
+
+#ifdef ACOUSTID_VINT_SSSE3
+
+namespace {
+
+// For every combination of continuation bits in 12 input bytes, this
+// describes how to move the first four varints into separate 32-bit
+// lanes, similar to the masked VByte algorithm. Only varints of at most
+// 4 bytes are handled, the rest is left to the scalar code.
+struct VInt32ShuffleTable
+{
+	struct Entry
+	{
+		uint8_t count;
+		uint8_t length;
+		uint16_t shuffle;
+	};
+
+	Entry entries[1 << 12];
+	uint8_t shuffles[1 + 4 + 4 * 4 + 4 * 4 * 4 + 4 * 4 * 4 * 4][16];
+
+	VInt32ShuffleTable()
+	{
+		memset(shuffles, 0x80, sizeof(shuffles));
+		for (int mask = 0; mask < (1 << 12); mask++) {
+			int sizes[4];
+			int pos = 0, n = 0;
+			while (n < 4) {
+				int size = 1;
+				while (pos + size - 1 < 12 && (mask & (1 << (pos + size - 1)))) {
+					size++;
+				}
+				if (pos + size - 1 >= 12 || size > 4) {
+					break;
+				}
+				sizes[n++] = size;
+				pos += size;
+			}
+			// Each sequence of varint sizes has its own shuffle
+			int index = 0, first = 0;
+			for (int i = 0; i < n; i++) {
+				index = index * 4 + sizes[i] - 1;
+				first = first * 4 + 1;
+			}
+			index += first;
+			uint8_t *shuffle = shuffles[index];
+			for (int i = 0, offset = 0; i < n; i++) {
+				for (int j = 0; j < sizes[i]; j++) {
+					shuffle[i * 4 + j] = offset++;
+				}
+			}
+			entries[mask].count = n;
+			entries[mask].length = pos;
+			entries[mask].shuffle = index;
+		}
+	}
+};
+
+const VInt32ShuffleTable kShuffleTable;
+
+__attribute__((target("ssse3")))
+ssize_t readVInt32ArrayFromArraySSSE3(const uint8_t *buffer, size_t length, uint32_t *values, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lowBits = _mm_set1_epi8(0x7F);
+	const __m128i byteWeights = _mm_set1_epi16(0x8001);
+	const __m128i pairWeights = _mm_set1_epi32(0x40000001);
+
+	size_t pos = 0, i = 0;
+
+	// Continuation bits of the bytes starting at pos, there are always at
+	// least 16 of them available at the start of each step. Bytes past the
+	// end of the data are treated as if they had no continuation bit. The
+	// bits are loaded from a separate offset, so that the loads don't have
+	// to wait for the previous step to finish.
+	uint64_t bits = 0;
+	int bitCount = 0;
+	size_t fill = 0;
+
+	while (i + 4 <= count) {
+		if (pos >= length) {
+			return -1;
+		}
+		if (bitCount < 16) {
+			uint64_t mask = 0;
+			if (fill < length) {
+				mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(buffer + fill)));
+				if (length - fill < 16) {
+					mask &= (1u << (length - fill)) - 1;
+				}
+			}
+			bits |= mask << bitCount;
+			bitCount += 16;
+			fill += 16;
+		}
+		__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buffer + pos));
+		if ((bits & 0xFFFF) == 0 && i + 16 <= count) {
+			// 16 single byte varints
+			__m128i lo = _mm_unpacklo_epi8(data, zero);
+			__m128i hi = _mm_unpackhi_epi8(data, zero);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(values + i + 4), _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(values + i + 8), _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(values + i + 12), _mm_unpackhi_epi16(hi, zero));
+			pos += 16;
+			bits >>= 16;
+			bitCount -= 16;
+			i += 16;
+			continue;
+		}
+		const VInt32ShuffleTable::Entry &entry = kShuffleTable.entries[bits & 0xFFF];
+		if (!entry.count) {
+			// 5 byte varint
+			ssize_t size = readVInt32FromArray(buffer + pos, &values[i]);
+			if (size == -1) {
+				return -1;
+			}
+			pos += size;
+			bits >>= size;
+			bitCount -= size;
+			i++;
+			continue;
+		}
+		// Spread the varint bytes into 32-bit lanes, then combine the 7-bit groups
+		__m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(kShuffleTable.shuffles[entry.shuffle]));
+		__m128i bytes = _mm_and_si128(_mm_shuffle_epi8(data, shuffle), lowBits);
+		__m128i pairs = _mm_maddubs_epi16(byteWeights, bytes);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), _mm_madd_epi16(pairs, pairWeights));
+		pos += entry.length;
+		bits >>= entry.length;
+		bitCount -= entry.length;
+		i += entry.count;
+	}
+	if (pos > length) {
+		// The last step decoded padding bytes past the end of the data
+		return -1;
+	}
+
+	ssize_t size = readVInt32ArrayFromArrayScalar(buffer + pos, length - std::min(pos, length), values + i, count - i);
+	if (size == -1) {
+		return -1;
+	}
+	return pos + size;
+}
+
+// For every control byte of a StreamVByte array, this describes how to
+// move the bytes of the four integers into separate 32-bit lanes.
+struct StreamVByte32ShuffleTable
+{
+	uint8_t lengths[256];
+	uint8_t shuffles[256][16];
+
+	StreamVByte32ShuffleTable()
+	{
+		memset(shuffles, 0x80, sizeof(shuffles));
+		for (int control = 0; control < 256; control++) {
+			int offset = 0;
+			for (int i = 0; i < 4; i++) {
+				int size = ((control >> (i * 2)) & 3) + 1;
+				for (int j = 0; j < size; j++) {
+					shuffles[control][i * 4 + j] = offset++;
+				}
+			}
+			lengths[control] = offset;
+		}
+	}
+};
+
+const StreamVByte32ShuffleTable kStreamVByteShuffleTable;
+
+__attribute__((target("ssse3")))
+ssize_t readStreamVByte32FromArraySSSE3(const uint8_t *buffer, size_t length, uint32_t *values, size_t count)
+{
+	size_t controlSize = streamVByte32ControlSize(count);
+	if (controlSize > length) {
+		return -1;
+	}
+	const uint8_t *control = buffer;
+	const uint8_t *data = buffer + controlSize;
+	size_t dataLength = length - controlSize;
+
+	size_t pos = 0, i = 0;
+	for (; i + 4 <= count; i += 4) {
+		if (pos > dataLength) {
+			return -1;
+		}
+		uint8_t c = control[i / 4];
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+		__m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(kStreamVByteShuffleTable.shuffles[c]));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), _mm_shuffle_epi8(bytes, shuffle));
+		pos += kStreamVByteShuffleTable.lengths[c];
+	}
+	if (pos > dataLength) {
+		return -1;
+	}
+
+	// Decode the remaining integers, using the same control byte layout
+	for (; i < count; i++) {
+		size_t size = ((control[i / 4] >> (i % 4 * 2)) & 3) + 1;
+		if (pos + size > dataLength) {
+			return -1;
+		}
+		uint32_t value = 0;
+		for (size_t j = 0; j < size; j++) {
+			value |= uint32_t(data[pos + j]) << (j * 8);
+		}
+		values[i] = value;
+		pos += size;
+	}
+	return controlSize + pos;
+}
+
+bool hasSSSE3()
+{
+	static const bool result = __builtin_cpu_supports("ssse3");
+	return result;
+}
+
+}
+
+#endif
+
+ssize_t readVInt32ArrayFromArray(const uint8_t *buffer, size_t length, uint32_t *values, size_t count)
+{
+#ifdef ACOUSTID_VINT_SSSE3
+	if (hasSSSE3()) {
+		return readVInt32ArrayFromArraySSSE3(buffer, length, values, count);
+	}
+#endif
+	return readVInt32ArrayFromArrayScalar(buffer, length, values, count);
+}
+
+ssize_t readStreamVByte32FromArray(const uint8_t *buffer, size_t length, uint32_t *values, size_t count)
+{
+#ifdef ACOUSTID_VINT_SSSE3
+	if (hasSSSE3()) {
+		return readStreamVByte32FromArraySSSE3(buffer, length, values, count);
+	}
+#endif
+	return readStreamVByte32FromArrayScalar(buffer, length, values, count);
+}
+
+}
@@ -122,6 +122,70 @@ done:
 	return ptr - buffer;
 }
 
+// Number of bytes that must be readable past the end of the data passed
+// to readVInt32ArrayFromArray()
+static const int kVInt32ArrayPadding = 16;
+
+// Read count 32-bit varints from an array of the given length. Returns the
+// number of bytes used, or -1 if the array doesn't contain enough varints.
+// Uses SIMD instructions if the CPU supports them.
+ssize_t readVInt32ArrayFromArray(const uint8_t *buffer, size_t length, uint32_t *values, size_t count);
+
+// Portable version of readVInt32ArrayFromArray()
+ssize_t readVInt32ArrayFromArrayScalar(const uint8_t *buffer, size_t length, uint32_t *values, size_t count);
+
+// Return the encoded size of a 32-bit integer in a StreamVByte array
+inline size_t checkStreamVByte32Size(uint32_t value)
+{
+	if (value < (1 << 8)) {
+		return 1;
+	}
+	if (value < (1 << 16)) {
+		return 2;
+	}
+	if (value < (1 << 24)) {
+		return 3;
+	}
+	return 4;
+}
+
+// Return the size of the control bytes of a StreamVByte array
+inline size_t streamVByte32ControlSize(size_t count)
+{
+	return (count + 3) / 4;
+}
+
+// Write count 32-bit integers to an unbounded array using the StreamVByte
+// encoding, i.e. 2-bit lengths of all integers followed by their bytes.
+// Returns the number of bytes written.
+inline size_t writeStreamVByte32ToArray(uint8_t *buffer, const uint32_t *values, size_t count)
+{
+	uint8_t *control = buffer;
+	uint8_t *ptr = buffer + streamVByte32ControlSize(count);
+	memset(control, 0, ptr - control);
+	for (size_t i = 0; i < count; i++) {
+		uint32_t value = values[i];
+		size_t size = checkStreamVByte32Size(value);
+		control[i / 4] |= (size - 1) << (i % 4 * 2);
+		for (size_t j = 0; j < size; j++) {
+			*(ptr++) = static_cast<uint8_t>(value >> (j * 8));
+		}
+	}
+	return ptr - buffer;
+}
+
+// Number of bytes that must be readable past the end of the data passed
+// to readStreamVByte32FromArray()
+static const int kStreamVByte32Padding = 16;
+
+// Read count StreamVByte encoded 32-bit integers from an array of the given
+// length. Returns the number of bytes used, or -1 if the array is too short.
+// Uses SIMD instructions if the CPU supports them.
+ssize_t readStreamVByte32FromArray(const uint8_t *buffer, size_t length, uint32_t *values, size_t count);
+
+// Portable version of readStreamVByte32FromArray()
+ssize_t readStreamVByte32FromArrayScalar(const uint8_t *buffer, size_t length, uint32_t *values, size_t count);
+
 }
 
 #endif
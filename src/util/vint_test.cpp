@@ -0,0 +1,102 @@
+// Copyright (C) 2011  Lukas Lalinsky
+// Distributed under the MIT license, see the LICENSE file for details.
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "util/test_utils.h"
+#include "util/vint.h"
+
+using namespace Acoustid;
+
+static std::vector<uint8_t> encodeVInt32Array(const std::vector<uint32_t> &values)
+{
+	std::vector<uint8_t> buffer(values.size() * kMaxVInt32Bytes + kVInt32ArrayPadding);
+	size_t size = 0;
+	for (size_t i = 0; i < values.size(); i++) {
+		size += writeVInt32ToArray(&buffer[size], values[i]);
+	}
+	buffer.resize(size + kVInt32ArrayPadding);
+	return buffer;
+}
+
+TEST(VIntTest, ReadVInt32Array)
+{
+	uint32_t seed = 1;
+	for (int bits = 1; bits <= 32; bits++) {
+		std::vector<uint32_t> values;
+		for (int i = 0; i < 1000; i++) {
+			seed = seed * 1103515245 + 12345;
+			uint32_t value = seed;
+			if (i % 7 == 0) {
+				value >>= 31;
+			}
+			else if (bits < 32) {
+				value &= (1u << (i % bits + 1)) - 1;
+			}
+			values.push_back(value);
+		}
+		std::vector<uint8_t> buffer = encodeVInt32Array(values);
+		size_t length = buffer.size() - kVInt32ArrayPadding;
+
+		std::vector<uint32_t> result(values.size());
+		ASSERT_EQ(length, readVInt32ArrayFromArray(buffer.data(), length, result.data(), result.size()));
+		ASSERT_INTARRAY_EQ(values, result, values.size());
+
+		std::vector<uint32_t> scalarResult(values.size());
+		ASSERT_EQ(length, readVInt32ArrayFromArrayScalar(buffer.data(), length, scalarResult.data(), scalarResult.size()));
+		ASSERT_INTARRAY_EQ(values, scalarResult, values.size());
+	}
+}
+
+TEST(VIntTest, ReadVInt32ArrayTooShort)
+{
+	std::vector<uint32_t> values(20, 1);
+	values.push_back(300);
+	std::vector<uint8_t> buffer = encodeVInt32Array(values);
+	size_t length = buffer.size() - kVInt32ArrayPadding;
+
+	std::vector<uint32_t> result(values.size() + 1);
+	ASSERT_EQ(-1, readVInt32ArrayFromArray(buffer.data(), length, result.data(), values.size() + 1));
+	ASSERT_EQ(-1, readVInt32ArrayFromArray(buffer.data(), length - 1, result.data(), values.size()));
+	ASSERT_EQ(-1, readVInt32ArrayFromArrayScalar(buffer.data(), length - 1, result.data(), values.size()));
+
+	// The requested number of varints ends exactly in the zero padding
+	std::vector<uint8_t> zeros(10 + kVInt32ArrayPadding, 0);
+	ASSERT_EQ(-1, readVInt32ArrayFromArray(zeros.data(), 10, result.data(), 16));
+	ASSERT_EQ(-1, readVInt32ArrayFromArrayScalar(zeros.data(), 10, result.data(), 16));
+	ASSERT_EQ(-1, readVInt32ArrayFromArray(zeros.data(), 3, result.data(), 4));
+	ASSERT_EQ(-1, readVInt32ArrayFromArrayScalar(zeros.data(), 3, result.data(), 4));
+	ASSERT_EQ(10, readVInt32ArrayFromArray(zeros.data(), 10, result.data(), 10));
+}
+
+TEST(VIntTest, ReadStreamVByte32Array)
+{
+	uint32_t seed = 1;
+	for (size_t count = 0; count < 40; count++) {
+		std::vector<uint32_t> values;
+		for (size_t i = 0; i < count; i++) {
+			seed = seed * 1103515245 + 12345;
+			values.push_back(seed >> (seed % 32));
+		}
+		std::vector<uint8_t> buffer(count * 5 + kStreamVByte32Padding);
+		size_t length = writeStreamVByte32ToArray(buffer.data(), values.data(), count);
+		size_t expectedLength = streamVByte32ControlSize(count);
+		for (size_t i = 0; i < count; i++) {
+			expectedLength += checkStreamVByte32Size(values[i]);
+		}
+		ASSERT_EQ(expectedLength, length);
+
+		std::vector<uint32_t> result(count);
+		ASSERT_EQ(length, readStreamVByte32FromArray(buffer.data(), length, result.data(), count));
+		ASSERT_INTARRAY_EQ(values, result, count);
+
+		std::vector<uint32_t> scalarResult(count);
+		ASSERT_EQ(length, readStreamVByte32FromArrayScalar(buffer.data(), length, scalarResult.data(), count));
+		ASSERT_INTARRAY_EQ(values, scalarResult, count);
+
+		if (count) {
+			ASSERT_EQ(-1, readStreamVByte32FromArray(buffer.data(), length - 1, result.data(), count));
+			ASSERT_EQ(-1, readStreamVByte32FromArrayScalar(buffer.data(), length - 1, scalarResult.data(), count));
+		}
+	}
+}